@@ -0,0 +1,358 @@
+/**@file contention.c
+@brief What a parallel make does to james
+
+A "make -jN" runs one james per source file, all of them
+against the same james.h, so they queue on its lock.
+This spawns N of those at once for growing N and reports
+how long they waited for the lock, how long they held it,
+the wall clock for the lot and whether james.h still came out
+right.
+
+Every synthetic source only adds two items to a list, so
+the result does not depend on the order the runs got the lock
+in and can be compared with one serial run over all sources.
+
+Build and run (POSIX only):
+
+	cc -O2 bench/contention.c -o contention
+	./contention ./james [N ...] [-- more james options]
+
+for example "./contention ./james 1 8 64 -- --optimistic".
+Without any N it tries 1 2 4 8 16 32 64 128. When the runs left
+a journal behind (--journal) one "james --compact" folds it into
+james.h after the clock has stopped, before the comparison.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_N 1024
+#define MAX_EXTRA 32
+#define NUM_LISTS 8
+
+char g_dir[] = "/tmp/james-contention-XXXXXX";
+char g_james_h[256];
+const char *g_james;
+const char *g_extra[MAX_EXTRA];
+int g_extra_c = 0;
+
+long now_ms(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+void src_name(char *buf, size_t sz, int i) {
+	snprintf(buf, sz, "%s/s%04d.c", g_dir, i);
+}
+/**
+@brief write sources 0..n-1 that each add two items to one of the lists
+*/
+void make_sources(int n) {
+	int i;
+	char name[256];
+	for (i = 0; i < n; ++i) {
+		FILE *f;
+		src_name(name, sizeof name, i);
+		f = fopen(name, "w");
+		if (f == NULL) {
+			perror(name);
+			exit(__LINE__);
+		}
+		fprintf(f, "/*#\nJAMES_ADD_TO_LIST\nLST%d\nitem_%d_a\nitem_%d_b\n#*/\n"
+			"int f%d(void) { return %d; }\n", i % NUM_LISTS, i, i, i, i);
+		fclose(f);
+	}
+}
+/**
+@brief remove path and, when it is a folder, everything in it
+*/
+void remove_tree(const char *path) {
+	DIR *d = opendir(path);
+	struct dirent *e;
+	char name[512];
+	if (d != NULL) {
+		while ((e = readdir(d)) != NULL) {
+			if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+				snprintf(name, sizeof name, "%s/%s", path, e->d_name);
+				remove_tree(name);
+			}
+		}
+		closedir(d);
+	}
+	remove(path);
+}
+/**
+@brief remove g_dir and whatever was left in it, at exit
+*/
+void remove_dir(void) {
+	remove_tree(g_dir);
+}
+/**
+@brief remove james.h and everything james keeps next to it
+*/
+void clean_header(void) {
+	static const char *ext[] = {"", ".state", ".cache", ".journal", ".d", ".lck", NULL};
+	char name[300];
+	int i;
+	for (i = 0; ext[i]; ++i) {
+		snprintf(name, sizeof name, "%s%s", g_james_h, ext[i]);
+		remove(name);
+	}
+}
+int cmp_line(const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+/**
+@brief james.h, sorted line by line without the "Generated on" line
+
+Which item ends up last in a list, and so without the ",\\" after
+it, and the order of the source files named above each list
+depend on who got the lock when, so those are left out too.
+@return a malloc'ed string or NULL when it cannot be read
+*/
+char *header_sorted(void) {
+	FILE *f = fopen(g_james_h, "r");
+	char **lines = NULL;
+	size_t c = 0;
+	size_t cap = 0;
+	size_t total = 1;
+	char buf[4096];
+	char *out;
+	size_t i;
+	if (f == NULL) {
+		return NULL;
+	}
+	while (fgets(buf, sizeof buf, f)) {
+		size_t len;
+		if (strncmp(buf, "Generated on", 12) == 0
+			|| strncmp(buf, "the source file(s)", 18) == 0) {
+			continue;
+		}
+		len = strlen(buf);
+		while (len > 0 && strchr(",\\\r\n", buf[len - 1])) {
+			--len;
+		}
+		buf[len] = '\0';
+		if (c == cap) {
+			cap = cap ? cap * 2 : 256;
+			lines = realloc(lines, cap * sizeof *lines);
+			if (lines == NULL) {
+				exit(__LINE__);
+			}
+		}
+		lines[c] = strdup(buf);
+		total += len + 1;
+		++c;
+	}
+	fclose(f);
+	qsort(lines, c, sizeof *lines, cmp_line);
+	out = malloc(total);
+	if (out == NULL) {
+		exit(__LINE__);
+	}
+	out[0] = '\0';
+	for (i = 0; i < c; ++i) {
+		strcat(out, lines[i]);
+		strcat(out, "\n");
+		free(lines[i]);
+	}
+	free(lines);
+	return out;
+}
+/**
+@brief start james on the given sources
+@param extra whether to pass the options after "--" and --stats
+@param fd_out where its stdout should go
+@return the child's pid
+*/
+pid_t spawn(int first, int count, int extra, int fd_out) {
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(__LINE__);
+	}
+	if (pid == 0) {
+		const char *argv[MAX_EXTRA + MAX_N + 8];
+		static char names[MAX_N][256];
+		int a = 0;
+		int i;
+		argv[a++] = g_james;
+		for (i = 0; extra && i < g_extra_c; ++i) {
+			argv[a++] = g_extra[i];
+		}
+		if (extra) {
+			argv[a++] = "--stats";
+		}
+		if (count == 0) {
+			argv[a++] = "--compact";
+		}
+		argv[a++] = g_james_h;
+		for (i = 0; i < count; ++i) {
+			src_name(names[i], sizeof names[i], first + i);
+			argv[a++] = names[i];
+		}
+		argv[a] = NULL;
+		dup2(fd_out, 1);
+		execv(g_james, (char *const *)argv);
+		perror(g_james);
+		_exit(127);
+	}
+	return pid;
+}
+struct run_stats {
+	long wait;
+	long locked;
+	long total;
+	int retries;
+	int status;
+};
+/**
+@brief pick the "stats:" line out of what one run printed
+*/
+void parse_stats(FILE *f, struct run_stats *s) {
+	char buf[4096];
+	while (fgets(buf, sizeof buf, f)) {
+		if (sscanf(buf, "stats: lock_wait_ms=%ld locked_ms=%ld total_ms=%ld retries=%d",
+			&s->wait, &s->locked, &s->total, &s->retries) == 4) {
+			return;
+		}
+	}
+}
+/**
+@brief n concurrent runs, one source each, then compare with the reference
+*/
+void bench(int n, const char *reference, FILE *devnull) {
+	static struct run_stats st[MAX_N];
+	FILE *out[MAX_N];
+	pid_t pid[MAX_N];
+	long t0;
+	long wall;
+	long sum_wait = 0;
+	long max_wait = 0;
+	long sum_locked = 0;
+	char journal[300];
+	int status;
+	int retries = 0;
+	int failed = 0;
+	char *got;
+	int i;
+	clean_header();
+	t0 = now_ms();
+	for (i = 0; i < n; ++i) {
+		/*--stdout goes to a temp file so a full pipe never holds a run up--*/
+		out[i] = tmpfile();
+		if (out[i] == NULL) {
+			perror("tmpfile");
+			exit(__LINE__);
+		}
+		pid[i] = spawn(i, 1, 1, fileno(out[i]));
+	}
+	for (i = 0; i < n; ++i) {
+		waitpid(pid[i], &st[i].status, 0);
+	}
+	wall = now_ms() - t0;
+	snprintf(journal, sizeof journal, "%s.journal", g_james_h);
+	if (access(journal, F_OK) == 0) {
+		waitpid(spawn(0, 0, 0, fileno(devnull)), &status, 0);
+	}
+	for (i = 0; i < n; ++i) {
+		st[i].wait = 0;
+		st[i].locked = 0;
+		st[i].total = 0;
+		st[i].retries = 0;
+		rewind(out[i]);
+		parse_stats(out[i], &st[i]);
+		fclose(out[i]);
+		if (!WIFEXITED(st[i].status) || WEXITSTATUS(st[i].status) != 0) {
+			++failed;
+		}
+		sum_wait += st[i].wait;
+		sum_locked += st[i].locked;
+		retries += st[i].retries;
+		if (st[i].wait > max_wait) {
+			max_wait = st[i].wait;
+		}
+	}
+	got = header_sorted();
+	printf("%5d %9ld %10.1f %10.1f %9ld %10.1f %8d  %s\n", n, wall,
+		wall ? n * 1000.0 / wall : 0.0,
+		(double)sum_wait / n, max_wait, (double)sum_locked / n, retries,
+		failed ? "EXIT" : (got && strcmp(got, reference) == 0) ? "OK" : "WRONG");
+	free(got);
+}
+int main(int argc, char **argv) {
+	int ns[64];
+	int n_c = 0;
+	int max_n = 0;
+	int argi;
+	int status;
+	char *reference;
+	FILE *devnull;
+	if (argc < 2) {
+		puts("usage: contention path/to/james [N ...] [-- more james options]");
+		return __LINE__;
+	}
+	g_james = argv[1];
+	for (argi = 2; argi < argc; ++argi) {
+		if (strcmp(argv[argi], "--") == 0) {
+			for (++argi; argi < argc && g_extra_c < MAX_EXTRA; ++argi) {
+				g_extra[g_extra_c++] = argv[argi];
+			}
+			break;
+		}
+		if (n_c < 64) {
+			ns[n_c] = atoi(argv[argi]);
+			if (ns[n_c] < 1 || ns[n_c] > MAX_N) {
+				printf("N must be 1..%d, not '%s'\n", MAX_N, argv[argi]);
+				return __LINE__;
+			}
+			++n_c;
+		}
+	}
+	if (n_c == 0) {
+		int n;
+		for (n = 1; n <= 128; n *= 2) {
+			ns[n_c++] = n;
+		}
+	}
+	for (argi = 0; argi < n_c; ++argi) {
+		if (ns[argi] > max_n) {
+			max_n = ns[argi];
+		}
+	}
+	if (mkdtemp(g_dir) == NULL) {
+		perror("mkdtemp");
+		return __LINE__;
+	}
+	atexit(remove_dir);
+	snprintf(g_james_h, sizeof g_james_h, "%s/james.h", g_dir);
+	make_sources(max_n);
+	devnull = fopen("/dev/null", "w");
+	if (devnull == NULL) {
+		perror("/dev/null");
+		return __LINE__;
+	}
+	printf("sources and james.h in %s, removed at exit\n", g_dir);
+	printf("%5s %9s %10s %10s %9s %10s %8s  %s\n", "N", "wall_ms", "runs/s",
+		"wait_avg", "wait_max", "held_avg", "retries", "james.h");
+	for (argi = 0; argi < n_c; ++argi) {
+		/*--the reference is one plain run over the same sources--*/
+		clean_header();
+		waitpid(spawn(0, ns[argi], 0, fileno(devnull)), &status, 0);
+		reference = header_sorted();
+		if (reference == NULL) {
+			printf("the reference run for N=%d made no james.h\n", ns[argi]);
+			return __LINE__;
+		}
+		bench(ns[argi], reference, devnull);
+		free(reference);
+	}
+	fclose(devnull);
+	return 0;
+}
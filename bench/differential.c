@@ -0,0 +1,538 @@
+/**@file differential.c
+@brief Checks that james still makes the same james.h as before
+
+For each seed a handful of synthetic sources is written, with
+lists, alias pluses and calls to them, comments and strings that
+only look like james blocks, and now and then odd lines such as a
+lone "\r", a "#JAM" that never becomes "#JAMES" or a backslash at
+the end. Then a reference james, built from before the change
+being checked, and the james being checked each make james.h from
+them, and both james.h and what was printed have to be the same.
+
+The james being checked makes it three ways, which all have to
+come out the same as the reference: in one run over all the
+sources, in one run with "-j 4", and in one run per source. When
+the reference passed, james.h also has to come out the same from
+one "--journal" run per source and a "--compact", with a half
+written record left at the end of the journal after the first, as
+by a run that died.
+
+Build and run (POSIX only):
+
+	git worktree add /tmp/james-ref HEAD~1
+	cc -O2 -pthread /tmp/james-ref/src/james.c -o james_ref
+	cc -O2 bench/differential.c -o differential
+	./differential ./james_ref ./james [SEEDS [FIRST]] [-- more james options]
+
+for example "./differential ./james_ref ./james 500 -- --cache".
+Without SEEDS it tries seeds 0 to 199. With "--per-source" before
+the two james the reference is run once per source, for a build
+from before it took more than one. The "Generated on" line and the
+"(1234)" line numbers of james itself in error messages are left
+out of the comparison, and so is the order of the lines printed.
+When the reference stops on an error only that and what was printed
+are compared, as what james.h holds then has changed over time.
+A seed that crashes the reference is skipped rather than counted.
+It stops at the first seed that differs and leaves its sources,
+otherwise the folder they were in is removed at exit.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define NUM_SOURCES 6
+#define MAX_EXTRA 32
+#define MAX_ALIASES 64
+
+char g_dir[] = "/tmp/james-differential-XXXXXX";
+char g_james_h[256];
+char g_names[NUM_SOURCES][256];
+const char *g_extra[MAX_EXTRA];
+int g_extra_c = 0;
+unsigned long long g_rng;
+/*--whether g_dir is kept at exit, to look at a seed that differs--*/
+int g_keep_dir = 0;
+
+/**
+@brief the next number of a xorshift, the same everywhere unlike rand()
+@return 0..n-1
+*/
+int rnd(int n) {
+	g_rng ^= g_rng << 13;
+	g_rng ^= g_rng >> 7;
+	g_rng ^= g_rng << 17;
+	return (int)(g_rng % (unsigned long long)n);
+}
+/**
+@brief one source of the seed, ending its lines with eol
+*/
+void make_source(FILE *f, int k, const char *eol, char aliases[][32], int *n_aliases) {
+	static const char *odd[] = {"/*#", "#*/", "#JAMES", "#JAM", "# JAMES",
+		"/*", "\r", "#*", "//", "*/", "\\", "\\ ", "\"", "#J", "#",
+		"  #  ", "\t/", "/", "(", ")", "AL_0_0(a, b)", "AL_1_0(x)y)"};
+	int b;
+	int blocks = rnd(5);
+	fprintf(f, "#include \"james.h\"%s/* file %d */%s", eol, k, eol);
+	for (b = 0; b < blocks; ++b) {
+		int r = rnd(100);
+		int c;
+		int lines = 5 + rnd(26);
+		if (r < 50) {
+			int v;
+			int items = 1 + rnd(4);
+			fprintf(f, "/*#%sJAMES_ADD_TO_LIST%sLIST_%d%s", eol, eol, rnd(6), eol);
+			for (v = 0; v < items; ++v) {
+				switch (rnd(4)) {
+				case 0: fprintf(f, "item_%d_%d%s", k, v, eol); break;
+				case 1: fprintf(f, "shared_%d%s", rnd(10), eol); break;
+				case 2: fprintf(f, "@_#_%d%s", v, eol); break;
+				default: fprintf(f, "\"@\"%s", eol); break;
+				}
+			}
+			fprintf(f, "#*/%s", eol);
+		}
+		else if (r < 65 && *n_aliases < MAX_ALIASES) {
+			char *a = aliases[(*n_aliases)++];
+			char lower[32];
+			int i;
+			snprintf(a, 32, "AL_%d_%d", k, b);
+			for (i = 0; a[i] != '\0'; ++i) {
+				lower[i] = (char)tolower((unsigned char)a[i]);
+			}
+			lower[i] = '\0';
+			fprintf(f, "/*#%sJAMES_ALIAS_PLUS%s%s($a, $b)%s3%sJAMES_ADD_TO_LIST%s"
+				"ALIST_%d%s%s_$a%sDEF_%s_$a%sint $a_x = $b;%sint $a_y = #;%s#*/%s",
+				eol, eol, a, eol, eol, eol, rnd(3), eol, lower, eol, a, eol, eol,
+				eol, eol);
+		}
+		for (c = 0; c < lines; ++c) {
+			int t = rnd(100);
+			if (t < 15 && *n_aliases > 0) {
+				static const char *lead[] = {"", "  ", "\t"};
+				static const char *tail[] = {"", ";", " /* x */"};
+				fprintf(f, "%s%s(v%d_%d, %d)%s%s", lead[rnd(3)],
+					aliases[rnd(*n_aliases)], k, c, c, tail[rnd(3)], eol);
+			}
+			else if (t < 30) {
+				fprintf(f, "  foo(%d); bar(x);%s", c, eol);
+			}
+			else if (t < 40) {
+				fprintf(f, "/* comment with AL_0_0(a,b) */%s", eol);
+			}
+			else if (t < 45) {
+				fprintf(f, "char *s = \"/*# not james\";%s", eol);
+			}
+			else if (t < 46) {
+				int i;
+				int parts = 1 + rnd(6);
+				for (i = 0; i < parts; ++i) {
+					fputs(rnd(2) ? odd[rnd(sizeof odd / sizeof *odd)] : "J", f);
+				}
+				fputs(eol, f);
+			}
+			else if (t < 48 && k == NUM_SOURCES - 1) {
+				/*--james blocks with no command are echoed as they are,
+				also one that starts a line after a lone CR, only by the
+				run that parses them so only the last source has them--*/
+				static const char *empty[] = {"/*#*/", "/*##*/", "/*# note #*/"};
+				fprintf(f, "%s%s%s", rnd(2) ? "int e;\r" : "",
+					empty[rnd(3)], eol);
+			}
+			else {
+				fprintf(f, "  int v%d = %d;%s", c, c, eol);
+			}
+		}
+	}
+}
+/**
+@brief write the sources of one seed
+*/
+void make_sources(unsigned long long seed) {
+	char aliases[MAX_ALIASES][32];
+	int n_aliases = 0;
+	int k;
+	g_rng = seed * 2654435761ULL + 88172645463325252ULL;
+	for (k = 0; k < NUM_SOURCES; ++k) {
+		FILE *f = fopen(g_names[k], "wb");
+		if (f == NULL) {
+			perror(g_names[k]);
+			exit(__LINE__);
+		}
+		/*--james commands do not end in "\r", so only now and then--*/
+		make_source(f, k, rnd(32) ? "\n" : "\r\n", aliases, &n_aliases);
+		fclose(f);
+	}
+}
+/**
+@brief remove path and, when it is a folder, everything in it
+*/
+void remove_tree(const char *path) {
+	DIR *d = opendir(path);
+	struct dirent *e;
+	char name[512];
+	if (d != NULL) {
+		while ((e = readdir(d)) != NULL) {
+			if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+				snprintf(name, sizeof name, "%s/%s", path, e->d_name);
+				remove_tree(name);
+			}
+		}
+		closedir(d);
+	}
+	remove(path);
+}
+/**
+@brief remove g_dir and whatever was left in it, at exit, unless g_keep_dir
+*/
+void remove_dir(void) {
+	if (!g_keep_dir) {
+		remove_tree(g_dir);
+	}
+}
+/**
+@brief remove james.h and everything james keeps next to it
+*/
+void clean_header(void) {
+	static const char *ext[] = {"", ".state", ".cache", ".journal", ".d", ".lck", NULL};
+	char name[300];
+	int i;
+	for (i = 0; ext[i]; ++i) {
+		snprintf(name, sizeof name, "%s%s", g_james_h, ext[i]);
+		remove(name);
+	}
+}
+/**
+@brief run james on sources first..first+count-1
+@param jobs the "-j" to give it, 0 for none
+@param extra whether to pass the options after "--"
+@param mode a james option to give it, such as "--journal", NULL for none
+@return its wait status
+*/
+int run(const char *james, int first, int count, int jobs, int extra, int fd_out,
+	const char *mode) {
+	int status;
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(__LINE__);
+	}
+	if (pid == 0) {
+		const char *argv[MAX_EXTRA + NUM_SOURCES + 8];
+		char jobs_s[16];
+		int a = 0;
+		int i;
+		argv[a++] = james;
+		if (jobs > 0) {
+			snprintf(jobs_s, sizeof jobs_s, "%d", jobs);
+			argv[a++] = "-j";
+			argv[a++] = jobs_s;
+		}
+		for (i = 0; extra && i < g_extra_c; ++i) {
+			argv[a++] = g_extra[i];
+		}
+		if (mode != NULL) {
+			argv[a++] = mode;
+		}
+		argv[a++] = g_james_h;
+		for (i = 0; i < count; ++i) {
+			argv[a++] = g_names[first + i];
+		}
+		argv[a] = NULL;
+		dup2(fd_out, 1);
+		execv(james, (char *const *)argv);
+		perror(james);
+		_exit(127);
+	}
+	waitpid(pid, &status, 0);
+	return status;
+}
+int cmp_line(const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+/**
+@brief the lines of f without "(1234)" line numbers of james itself
+@param skip_generated whether to leave out the "Generated on" line
+@param sorted whether to sort the lines
+@return a malloc'ed string
+*/
+char *normalized(FILE *f, int skip_generated, int sorted) {
+	char **lines = NULL;
+	size_t c = 0;
+	size_t cap = 0;
+	size_t total = 1;
+	char buf[8192];
+	char *out;
+	size_t i;
+	while (fgets(buf, sizeof buf, f)) {
+		char *r;
+		char *w;
+		if (skip_generated && strncmp(buf, "Generated on", 12) == 0) {
+			continue;
+		}
+		for (r = w = buf; *r != '\0'; ) {
+			if (*r == '(' && isdigit((unsigned char)r[1])) {
+				char *e = r + 1;
+				while (isdigit((unsigned char)*e)) {
+					++e;
+				}
+				if (*e == ')') {
+					r = e + 1;
+					continue;
+				}
+			}
+			*w++ = *r++;
+		}
+		*w = '\0';
+		if (c == cap) {
+			cap = cap ? cap * 2 : 256;
+			lines = realloc(lines, cap * sizeof *lines);
+			if (lines == NULL) {
+				exit(__LINE__);
+			}
+		}
+		lines[c] = strdup(buf);
+		total += strlen(buf);
+		++c;
+	}
+	if (sorted) {
+		qsort(lines, c, sizeof *lines, cmp_line);
+	}
+	out = malloc(total);
+	if (out == NULL) {
+		exit(__LINE__);
+	}
+	out[0] = '\0';
+	for (i = 0; i < c; ++i) {
+		strcat(out, lines[i]);
+		free(lines[i]);
+	}
+	free(lines);
+	return out;
+}
+struct outcome {
+	int failed;
+	int crashed;
+	char *header;
+	char *printed;
+};
+/**
+@brief make james.h from nothing with james, one way
+@param jobs the "-j" to give it, 0 for none
+@param per_source whether to run it once per source
+*/
+void make_header(const char *james, int jobs, int per_source, struct outcome *o) {
+	FILE *out = tmpfile();
+	FILE *h;
+	int k;
+	if (out == NULL) {
+		perror("tmpfile");
+		exit(__LINE__);
+	}
+	o->failed = 0;
+	o->crashed = 0;
+	clean_header();
+	for (k = 0; k < NUM_SOURCES; k += per_source ? 1 : NUM_SOURCES) {
+		int status = run(james, k, per_source ? 1 : NUM_SOURCES, jobs, 1, fileno(out), NULL);
+		if (WIFSIGNALED(status)) {
+			o->crashed = 1;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			/*--the same as a build would, stop at the first error--*/
+			o->failed = 1;
+			break;
+		}
+	}
+	rewind(out);
+	o->printed = normalized(out, 0, 1);
+	fclose(out);
+	h = fopen(g_james_h, "rb");
+	if (h != NULL) {
+		o->header = normalized(h, 1, 0);
+		fclose(h);
+	}
+	else {
+		o->header = strdup("");
+	}
+}
+/**
+@brief make james.h with one "--journal" run per source and then
+"--compact", leaving a half written record at the end of the journal
+after the first run, which the next run has to cut off
+*/
+void make_header_torn(const char *james, struct outcome *o) {
+	FILE *out = tmpfile();
+	FILE *h;
+	char journal[300];
+	int k;
+	if (out == NULL) {
+		perror("tmpfile");
+		exit(__LINE__);
+	}
+	o->failed = 0;
+	o->crashed = 0;
+	clean_header();
+	snprintf(journal, sizeof journal, "%s.journal", g_james_h);
+	for (k = 0; k <= NUM_SOURCES; ++k) {
+		int status = (k < NUM_SOURCES)
+			? run(james, k, 1, 0, 1, fileno(out), "--journal")
+			: run(james, 0, 0, 0, 1, fileno(out), "--compact");
+		if (WIFSIGNALED(status)) {
+			o->crashed = 1;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			o->failed = 1;
+			break;
+		}
+		if (k == 0) {
+			FILE *j = fopen(journal, "ab");
+			if (j == NULL) {
+				perror(journal);
+				exit(__LINE__);
+			}
+			fputs("J 4096 0123456789abcdef\nS 0 half", j);
+			fclose(j);
+		}
+	}
+	rewind(out);
+	o->printed = normalized(out, 0, 1);
+	fclose(out);
+	h = fopen(g_james_h, "rb");
+	if (h != NULL) {
+		o->header = normalized(h, 1, 0);
+		fclose(h);
+	}
+	else {
+		o->header = strdup("");
+	}
+}
+/**
+@brief print the first line where a and b part
+*/
+void show_first_difference(const char *what, const char *a, const char *b) {
+	size_t i = 0;
+	size_t line = 0;
+	while (a[i] != '\0' && a[i] == b[i]) {
+		if (a[i++] == '\n') {
+			line = i;
+		}
+	}
+	if (a[i] == b[i]) {
+		return;
+	}
+	printf("  %s, reference: %.*s\n", what, (int)strcspn(a + line, "\n"), a + line);
+	printf("  %s, checked:   %.*s\n", what, (int)strcspn(b + line, "\n"), b + line);
+}
+int same_outcome(const struct outcome *a, const struct outcome *b) {
+	if (a->failed != b->failed) {
+		printf("  the reference %s, the checked one %s\n", a->failed ? "failed" : "passed",
+			b->failed ? "failed" : "passed");
+	}
+	/*--what is left in james.h after an error is no promise--*/
+	if (!a->failed) {
+		show_first_difference("james.h", a->header, b->header);
+	}
+	show_first_difference("printed", a->printed, b->printed);
+	return a->failed == b->failed && (a->failed || strcmp(a->header, b->header) == 0)
+		&& strcmp(a->printed, b->printed) == 0;
+}
+void free_outcome(struct outcome *o) {
+	free(o->header);
+	free(o->printed);
+}
+int main(int argc, char **argv) {
+	static const char *way[] = {"one run", "-j 4", "one run per source"};
+	const char *reference;
+	const char *james;
+	int ref_per_source = 0;
+	long seeds = 200;
+	long first = 0;
+	long seed;
+	long diffs = 0;
+	long skipped = 0;
+	long failing = 0;
+	int argi = 1;
+	int k;
+	if (argi < argc && strcmp(argv[argi], "--per-source") == 0) {
+		ref_per_source = 1;
+		++argi;
+	}
+	if (argc - argi < 2) {
+		puts("usage: differential [--per-source] path/to/reference/james path/to/james [SEEDS [FIRST]] [-- more james options]");
+		return __LINE__;
+	}
+	reference = argv[argi++];
+	james = argv[argi++];
+	if (argi < argc && strcmp(argv[argi], "--") != 0) {
+		seeds = atol(argv[argi++]);
+	}
+	if (argi < argc && strcmp(argv[argi], "--") != 0) {
+		first = atol(argv[argi++]);
+	}
+	if (argi < argc && strcmp(argv[argi], "--") == 0) {
+		for (++argi; argi < argc && g_extra_c < MAX_EXTRA; ++argi) {
+			g_extra[g_extra_c++] = argv[argi];
+		}
+	}
+	if (mkdtemp(g_dir) == NULL) {
+		perror("mkdtemp");
+		return __LINE__;
+	}
+	atexit(remove_dir);
+	snprintf(g_james_h, sizeof g_james_h, "%s/james.h", g_dir);
+	for (k = 0; k < NUM_SOURCES; ++k) {
+		snprintf(g_names[k], sizeof g_names[k], "%s/s%d.c", g_dir, k);
+	}
+	printf("sources and james.h in %s\n", g_dir);
+	for (seed = first; seed < first + seeds; ++seed) {
+		struct outcome ref;
+		int w;
+		make_sources((unsigned long long)seed);
+		make_header(reference, 0, ref_per_source, &ref);
+		if (ref.crashed) {
+			++skipped;
+			free_outcome(&ref);
+			continue;
+		}
+		failing += ref.failed;
+		for (w = 0; w < 3; ++w) {
+			struct outcome got;
+			make_header(james, w == 1 ? 4 : 0, w == 2, &got);
+			if (!same_outcome(&ref, &got)) {
+				printf("seed %ld differs, %s%s\n", seed, way[w],
+					got.crashed ? " crashed" : "");
+				++diffs;
+				free_outcome(&got);
+				break;
+			}
+			free_outcome(&got);
+		}
+		if (!diffs && !ref.failed) {
+			/*--what it prints has the warnings about the torn journal--*/
+			struct outcome got;
+			make_header_torn(james, &got);
+			show_first_difference("james.h", ref.header, got.header);
+			if (got.failed || strcmp(ref.header, got.header) != 0) {
+				printf("seed %ld differs, --journal with a torn record%s%s\n", seed,
+					got.failed ? " failed" : "", got.crashed ? " crashed" : "");
+				++diffs;
+			}
+			free_outcome(&got);
+		}
+		free_outcome(&ref);
+		if (diffs) {
+			/*--keep what differed to look at--*/
+			g_keep_dir = 1;
+			printf("the sources of seed %ld are left in %s\n", seed, g_dir);
+			return 1;
+		}
+	}
+	printf("%ld seeds, %ld differ, %ld with an error in james.h, %ld skipped as the reference crashed\n",
+		seeds, diffs, failing, skipped);
+	return diffs ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+/**@file libjames.h
+@brief the james engine as a library, for build tools that would
+rather call it than run the james program once per source file
+
+Build it from the same source as the program, with no main():
+
+	cc -c -DJAMES_NO_MAIN src/james.c -o libjames.o
+	ar rcs libjames.a libjames.o
+
+Each james_session holds the lists, alias_pluses and invocations
+of one james.h, any number of them can be held at once. The
+engine itself is still one set of globals that a session is
+swapped into for the length of each call, so call it from one
+thread at a time. Errors are printed to stderr, stdout being the
+host's, and returned as the line number of where they were tested.
+Where the program would exit, on no ram or a lock it cannot get,
+the call returns instead, so a session a call failed on may hold
+only part of what it was given and is best freed.
+*/
+#ifndef libjames_h
+#define libjames_h
+#include <stdio.h>
+
+struct james_session;
+
+/**
+@return a new empty session, NULL on no ram
+*/
+struct james_session* james_session_new(void);
+/**
+Frees the session and everything it holds.
+*/
+void james_session_free(struct james_session* s);
+/**
+Adds what one source file contributes, as if it were given to
+the james program after everything added so far.
+@param buf
+the content of the source file, need not be null terminated
+@param len
+how many bytes buf has
+@param name
+the source file path, only its file name is kept, for the
+"@name:line$" markers and messages
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+int james_add_source(struct james_session* s, const char* buf, long len,
+	const char* name);
+/**
+Replaces whatever the session holds with the content of an
+existing james.h, from its ".state" snapshot when that goes with
+it. A james.h that does not exist leaves the session empty.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+int james_load_state(struct james_session* s, const char* james_h);
+/**
+Writes out the complete james.h for what the session holds.
+@param out
+where to write it, for instance a file opened with "w" or an
+open_memstream()
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+int james_render(struct james_session* s, FILE* out);
+/**
+Writes james_h for what the session holds the way the program
+does, under its lock, only moving it into place if it changed,
+and with its ".state" snapshot.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+int james_write(struct james_session* s, const char* james_h);
+#endif
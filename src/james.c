@@ -13,6 +13,14 @@ You may need to add your own file locking lock() and
 unlock() functions which may simply do nothing if you will
 run the tool serially, not in parallel.
 
+The lock is "james.h.lck" next to the james.h being made, so only
+runs on the same james.h wait for each other, for as long as
+"--lock-timeout seconds" allows (forever by default), and
+"--stats" prints how long they waited. With "--optimistic" it is not locked
+while james.h is loaded and added to, only while checking nobody
+else wrote james.h meanwhile and moving the new one into place,
+starting again if someone did.
+
 #Mechanical Usage Scenario(s)
 Build and run the james tool locally, should be as simple
 as "cc tools/james.c -o james" which should compile and
@@ -36,7 +44,126 @@ add to ram the things it finds. then it will re-generate the
 "include/james.h" file as the output. So at the end of the
 pre-build header-update step, all source files have been
 able to contribute their results into the combined header
-file.
+file. It is written as "include/james.h.tmp" and only renamed
+over "include/james.h" when something other than the
+"Generated on" line differs, so its modified time only changes
+when its content does. Next to it "include/james.h.state" is
+written, a snapshot of everything james holds in ram, which the
+next run loads in one go instead of parsing the ram dump in
+"include/james.h" again, for as long as "include/james.h" is
+the same one it was written with.
+
+With "--shard-dir james" each list goes into a header of its own,
+"include/james/BUILT_IN_MODULES.h" and so on, and each alias plus
+with all its invocations likewise, which "include/james.h"
+includes. A source file including only the one it needs is only
+rebuilt when that one changes, as each is only written when it
+changed.
+
+With "-MD" the source files that contributed anything are written
+to "include/james.h.d" (or the file given with "-MF") as a make
+style depfile, for make or ninja to only run james again when one
+of them changed. Each of them is a target of its own in it too, as
+with "-MP", so make goes on when one of them is deleted.
+
+Or, so that "make -j" does not have every job waiting on the lock
+for "include/james.h", have each job run "./james --spool spool
+src/main.c", which writes what src/main.c contributes to a file of
+its own in the folder "spool" with no lock at all, and then once
+"./james --merge spool include/james.h" which applies all of them
+in order of their source file paths. Nothing is ever removed from
+"spool", so delete it in Step 1 too.
+
+Or have each job run "./james --journal include/james.h
+src/main.c" which only appends what src/main.c contributes to
+"include/james.h.journal", and then once "./james --compact
+include/james.h" which applies the journal to "include/james.h"
+and removes it, as does any run that writes "include/james.h".
+With "--compact-at bytes" a job does that itself once the journal
+is that big.
+
+Which of these suits a build best, "--stats" prints how long the
+run waited for the lock, held it and took in all, and
+"bench/contention.c" runs N of them at once for growing N and
+checks james.h still comes out right.
+
+Build tools can also skip running james at all: built with
+-DJAMES_NO_MAIN this file is a library, see lib/libjames.h, where
+a james_session is given source files as buffers and renders or
+writes james.h in the same process. Everything else in here is
+static, so the functions of lib/libjames.h are all it exports.
+
+Better still run "./james include/james.h src/main.c src/util.c" or
+"./james include/james.h @filelist" where filelist has one
+source file path per line. Then "include/james.h" is read
+and written only once for the whole lot, the source files
+being processed in the order given, which gives the same
+result as running it once per source file in that order.
+Add "-j 8" before "include/james.h" to parse the source files
+on 8 threads ("-j 0" for one per cpu), they are still applied
+in the order given so the result is the same byte for byte.
+Threads need POSIX, build with "cc tools/james.c -o james
+-lpthread" if your libc wants it, or -DJAMES_NO_THREADS.
+On Linux they are read through io_uring, see "--no-uring" and
+-DJAMES_NO_URING.
+Where SSE2 is there, which is any x86-64, the source files are
+searched 16 characters at a time for where anything james cares
+about could be, or 32 when built with -mavx2, and -DJAMES_NO_SIMD
+leaves that to plain C.
+
+Or let james find them: "./james --scan-dir src --exclude
+third_party include/james.h" walks "src" and the folders in it
+other than any called third_party, on the "-j" threads too, and
+takes the source files found in the order of their paths after
+any named. Without "--include glob"
+those are the files ending in .c .h .cc .cpp .cxx .hh .hpp .hxx
+or .inl. Globs with a "/" in them match the path from "src",
+others only the file name, "*" matching anything but "/" and "**"
+anything at all. Names starting with ".", symbolic links, files
+bigger than "--max-size bytes" (16MB by default, 0 for any size),
+and james.h and its shards are left out.
+
+Where james may not make lock or temp files, such as a sandboxed
+build step, "./james --stdin --name-from-markers -o -" takes the
+source files in on stdin, each starting with a line such as
+#line 1 "src/main.c", and writes james.h out to stdout, or with
+"-o include/james.h" to a file. Give an existing james.h after
+the options to start from what it holds.
+
+On Linux "./james --watch include/james.h src" makes
+"include/james.h" from every source file in "src" and the folders
+in it, in the order of their paths, and then keeps running, parsing
+again only the ones that change and writing "include/james.h" once
+nothing changed for "--debounce ms" (100 by default), so it is
+already up to date when make runs. Stop it with Ctrl+C.
+
+On POSIX "./james --daemon /tmp/james.sock" keeps everything in
+ram between builds, and then "./james --client /tmp/james.sock
+include/james.h src/main.c" has it parse src/main.c with no
+reloading of "include/james.h", what src/main.c gave before being
+replaced when it is sent again. The daemon writes out each
+james.h that changed once it has had no requests for a couple of
+seconds (--idle-flush), or when sent "--client sock --flush
+include/james.h". Instead of deleting "include/james.h" in Step 1
+send "--client sock --reset include/james.h" so it is forgotten,
+and "--client sock --stop" writes everything out and stops it.
+While the daemon runs, only change james.h through it.
+
+With "--cache" what each source file contributed is remembered
+in "include/james.h.cache" along with the size, modified and
+changed times, inode and a hash of the contents of the source
+file. Next time any source file with all of those the same, or
+the same size and hash, is not parsed at all (one modified no
+earlier than the cache file is always hashed, as it could have
+changed again since), what it contributed last time is used
+instead, so Step 1 and Step 2 for the whole project only cost as
+much as the source files that changed. When "include/james.h"
+was made by "--cache" from nothing (deleted in Step 1) and is
+untouched since, the cache also knows which source file
+contributed what, so Step 1 can be skipped: the source files
+given are parsed again and replace what they contributed before,
+and "--forget src/gone.c" drops what a deleted source file
+contributed.
 
 ##Step 3
 Build source files as per normal, i.e. "cc -Iinclude src/main.c".
@@ -63,27 +190,132 @@ changed.
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#include <setjmp.h>
+
+#ifdef JAMES_NO_MAIN
+#include <stdarg.h>
+/*--as a library stdout is the host's, so what james says goes to
+stderr instead--*/
+static int lib_printf(const char* format, ...) {
+	va_list ap;
+	int n;
+	va_start(ap, format);
+	n = vfprintf(stderr, format, ap);
+	va_end(ap);
+	return n;
+}
+static int lib_puts(const char* s) {
+	if (fputs(s, stderr) == EOF) {
+		return EOF;
+	}
+	return fputc('\n', stderr);
+}
+#define printf lib_printf
+#define puts lib_puts
+#endif
+/*--where the james_* call of lib/libjames.h gives up to, and the
+line it gave up on--*/
+static jmp_buf g_lib_bail;
+static int g_lib_bail_line = 0;
+/**
+Gives up on the program, or as a library only on the james_* call
+that got here, which returns line, as the host must go on.
+*/
+static void give_up(int line) {
+#ifdef JAMES_NO_MAIN
+	g_lib_bail_line = line;
+	longjmp(g_lib_bail, 1);
+#else
+	exit(line);
+#endif
+}
 
-#define LINEBUF_LEN 250
-
-void genericDie(long line) {
+static void genericDie(long line) {
 	printf("failed on line %ld\n", line);
-	exit(__LINE__);
+	give_up(__LINE__);
 }
 
+/*--the file that is locked while james.h is being changed, see
+lock_set_target(), room for a whole folder path, a file name and
+".lck"--*/
+static char g_lock_path[4096 + 256 + 5] = "james.lck";
+/*--seconds to wait for the lock before giving up, 0 is forever--*/
+static int g_lock_timeout = 0;
+/*--how long the last lock() had to wait, in milliseconds--*/
+static long g_lock_wait_ms = 0;
+/*--for --stats, all of them added up, and how long it was held--*/
+static long g_lock_wait_total_ms = 0;
+static long g_lock_held_ms = 0;
+static long g_locked_at_ms = -1;
+#ifndef JAMES_NO_MAIN
+/*--how many times --optimistic starts again before it waits for
+the lock like everyone else--*/
+static int g_optimistic_retries = 8;
+#endif
+
 #ifdef _POSIX_SOURCE
-int isdebug(void) {
+static int isdebug(void) {
 	return 0;
 }
 #include <unistd.h>
-void the_sleep(int n) {
-	sleep(n);
-}
 #include <fcntl.h>
-const char* fname = "/tmp/james.lck";
-void lock(/*const char *fname*/void) {
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <limits.h>
+static long now_ms(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+static int g_lock_fd = -1;
+/**
+Locks "james.h.lck" next to the james.h, so that only runs on the
+same james.h wait for each other. Its folder is made canonical so
+that every path to the same james.h gives the same lock.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int lock_set_target(const char* james_h) {
+	char dir[4096];
+	char real[PATH_MAX];
+	const char* base = strrchr(james_h, '/');
+	if (base == NULL) {
+		snprintf(dir, sizeof dir, ".");
+		base = james_h;
+	}
+	else {
+		snprintf(dir, sizeof dir, "%.*s",
+			base == james_h ? 1 : (int)(base - james_h), james_h);
+		++base;
+	}
+	if (realpath(dir, real) != NULL
+		&& snprintf(g_lock_path, sizeof g_lock_path, "%s/%s.lck",
+			strcmp(real, "/") == 0 ? "" : real, base)
+			< (int)sizeof g_lock_path) {
+		return 0;
+	}
+	/*--a cut short path would lock some other file--*/
+	if (snprintf(g_lock_path, sizeof g_lock_path, "%s.lck", james_h)
+		>= (int)sizeof g_lock_path) {
+		printf("error the path '%s' is too long to lock\n", james_h);
+		return __LINE__;
+	}
+	return 0;
+}
+static void lock_alarm(int sig) {
+	(void)sig;
+}
+/**
+Waits for the lock of lock_set_target(), for at most --lock-timeout.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int lock(/*const char *fname*/void) {
 	struct flock fl;
-    int fd;
+	struct timespec t0;
+	struct timespec t1;
+	int ret;
 	
 	memset(&fl,0,sizeof fl);
 	
@@ -91,37 +323,58 @@ void lock(/*const char *fname*/void) {
     fl.l_whence = SEEK_SET;/*SEEK_SET, SEEK_CUR, SEEK_END*/
     fl.l_start  = 0;       /*Offset from l_whence        */
     fl.l_len    = 0;       /*length, 0 = to EOF          */
-    fl.l_pid    = getpid();/*our PID                     */
-	fd = open(fname, O_WRONLY);
-    fcntl(fd, F_SETLKW, &fl);/* F_GETLK, F_SETLK, F_SETLKW*/
-	close(fd);	
-}
-void unlock(/*const char *fname*/void) {
-	struct flock fl;
-    int fd;
-	
-	memset(&fl,0,sizeof fl);
-
-    fl.l_type   = F_WRLCK;  /*F_RDLCK, F_WRLCK, F_UNLCK   */
-    fl.l_whence = SEEK_SET; /*SEEK_SET, SEEK_CUR, SEEK_END*/
-    fl.l_start  = 0;        /*Offset from l_whence        */
-    fl.l_len    = 0;        /*length, 0 = to EOF          */
-    fl.l_pid    = getpid(); /*our PID                     */
-
-	/* get the file descriptor */
-    fd = open(fname, O_WRONLY);
+	g_lock_wait_ms = 0;
+	g_lock_fd = open(g_lock_path, O_RDWR | O_CREAT, 0666);
+	if (g_lock_fd < 0) {
+		printf("error cannot open lock file '%s'\n", g_lock_path);
+		return __LINE__;
+	}
+	if (fcntl(g_lock_fd, F_SETLK, &fl) == 0) {
+		g_locked_at_ms = now_ms();
+		return 0;
+	}
 
-	/* tell it to unlock the region */
-    fl.l_type   = F_UNLCK;
-	/* set the region to unlocked */
-    fcntl(fd, F_SETLK, &fl);
-	close(fd);
+	/*--someone else has it, so block until they are done, the
+	alarm interrupting it if it takes longer than --lock-timeout--*/
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (g_lock_timeout > 0) {
+		struct sigaction sa;
+		memset(&sa, 0, sizeof sa);
+		sa.sa_handler = lock_alarm;
+		sigaction(SIGALRM, &sa, NULL);
+		alarm((unsigned)g_lock_timeout);
+	}
+	ret = fcntl(g_lock_fd, F_SETLKW, &fl);
+	if (g_lock_timeout > 0) {
+		alarm(0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	g_lock_wait_ms = (long)(t1.tv_sec - t0.tv_sec) * 1000
+		+ (t1.tv_nsec - t0.tv_nsec) / 1000000;
+	if (ret != 0) {
+		printf("error gave up waiting for the lock '%s' after %ld ms\n",
+			g_lock_path, g_lock_wait_ms);
+		close(g_lock_fd);
+		g_lock_fd = -1;
+		return __LINE__;
+	}
+	g_lock_wait_total_ms += g_lock_wait_ms;
+	g_locked_at_ms = now_ms();
+	return 0;
+}
+static void unlock(/*const char *fname*/void) {
+	/*--closing it lets go of the lock--*/
+	if (g_lock_fd >= 0) {
+		close(g_lock_fd);
+		g_lock_fd = -1;
+		g_lock_held_ms += now_ms() - g_locked_at_ms;
+	}
 }
 #else
 
 #ifdef _MSC_VER
 #include <Windows.h>
-void the_sleep(int n) {
+static void the_sleep(int n) {
 	Sleep(n*1000);
 }
 #endif
@@ -133,7 +386,7 @@ void _Cdecl sound(unsigned __frequency);
 #endif
 */
 #include <dos.h>
-void the_sleep(int n) {
+static void the_sleep(int n) {
 	sleep(n);
 }
 #endif
@@ -142,74 +395,168 @@ void the_sleep(int n) {
 
 #ifdef _MSC_VER
 #include <debugapi.h>
-int isdebug(void) {
+static int isdebug(void) {
 	return IsDebuggerPresent();
 }
 #else
-int isdebug(void) {
+static int isdebug(void) {
 	return 0;
 }
 #endif
 
-const char* jmslck = "james.lck";
-char buffer [L_tmpnam];
-int buffer_inited=0;
-#define LFILE "C:\\temp\\james.lck";
-#ifdef __LINUX__
-#undef LFILE
-#define LFILE "/tmp/james.lck"
-#endif
+#ifdef _MSC_VER
+static long now_ms(void) {
+	return (long)GetTickCount();
+}
+static HANDLE g_lock_handle = INVALID_HANDLE_VALUE;
+/**
+Locks "james.h.lck" next to the james.h, so that only runs on the
+same james.h wait for each other, see the POSIX one.
+*/
+static int lock_set_target(const char* james_h) {
+	char full[4096];
+	if (GetFullPathNameA(james_h, sizeof full, full, NULL) > 0
+		&& snprintf(g_lock_path, sizeof g_lock_path, "%s.lck", full)
+			< (int)sizeof g_lock_path) {
+		return 0;
+	}
+	if (snprintf(g_lock_path, sizeof g_lock_path, "%s.lck", james_h)
+		>= (int)sizeof g_lock_path) {
+		printf("error the path '%s' is too long to lock\n", james_h);
+		return __LINE__;
+	}
+	return 0;
+}
+static int lock(void) {
+	OVERLAPPED ov;
+	DWORD t0;
+	DWORD waited;
+	g_lock_wait_ms = 0;
+	g_lock_handle = CreateFileA(g_lock_path, GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+	if (g_lock_handle == INVALID_HANDLE_VALUE) {
+		printf("error cannot open lock file '%s'\n", g_lock_path);
+		return __LINE__;
+	}
+	memset(&ov, 0, sizeof ov);
+	ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (ov.hEvent == NULL) {
+		printf("error cannot lock '%s'\n", g_lock_path);
+		CloseHandle(g_lock_handle);
+		g_lock_handle = INVALID_HANDLE_VALUE;
+		return __LINE__;
+	}
+	if (LockFileEx(g_lock_handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) {
+		CloseHandle(ov.hEvent);
+		g_locked_at_ms = now_ms();
+		return 0;
+	}
+	if (GetLastError() != ERROR_IO_PENDING) {
+		printf("error cannot lock '%s'\n", g_lock_path);
+		CloseHandle(ov.hEvent);
+		CloseHandle(g_lock_handle);
+		g_lock_handle = INVALID_HANDLE_VALUE;
+		return __LINE__;
+	}
+
+	/*--someone else has it, so wait until they are done--*/
+	t0 = GetTickCount();
+	waited = WaitForSingleObject(ov.hEvent,
+		g_lock_timeout > 0 ? (DWORD)g_lock_timeout * 1000 : INFINITE);
+	g_lock_wait_ms = (long)(GetTickCount() - t0);
+	CloseHandle(ov.hEvent);
+	if (waited != WAIT_OBJECT_0) {
+		CancelIo(g_lock_handle);
+		CloseHandle(g_lock_handle);
+		g_lock_handle = INVALID_HANDLE_VALUE;
+		printf("error gave up waiting for the lock '%s' after %ld ms\n",
+			g_lock_path, g_lock_wait_ms);
+		return __LINE__;
+	}
+	g_lock_wait_total_ms += g_lock_wait_ms;
+	g_locked_at_ms = now_ms();
+	return 0;
+}
+static void unlock(void) {
+	/*--closing it lets go of the lock--*/
+	if (g_lock_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(g_lock_handle);
+		g_lock_handle = INVALID_HANDLE_VALUE;
+		g_lock_held_ms += now_ms() - g_locked_at_ms;
+	}
+}
+#else
+#include <time.h>
+static long now_ms(void) {
+	return (long)(clock() * 1000 / CLOCKS_PER_SEC);
+}
+/**
+Locks "james.h.lck" next to the james.h, like on POSIX, by the
+lock file being there at all.
+*/
+static int lock_set_target(const char* james_h) {
+	/*--a cut short path would lock some other file--*/
+	if (strlen(james_h) + sizeof ".lck" > sizeof g_lock_path) {
+		printf("error the path '%s' is too long to lock\n", james_h);
+		return __LINE__;
+	}
+	sprintf(g_lock_path, "%s.lck", james_h);
+	return 0;
+}
 
-void lock(/*const char *fname*/void) {
+static int lock(/*const char *fname*/void) {
 	FILE *f;
 	int warned = 0;
-	
-	if(!buffer_inited)
-	{
-		tmpnam (buffer);
-		buffer_inited = 1;
-		int i;
-		for(i=strlen(buffer);i>0;--i){
-			if(buffer[i]=='/' || buffer[i]=='\\') {
-				buffer[i]='\0';
-				break;
-			}
-		}
-		memcpy(buffer+strlen(buffer),jmslck,
-			strlen(jmslck)+1);
-	}
-	
+	time_t t0 = time(NULL);
+
 	while(1) {
-		f = fopen(buffer,"r");
+		f = fopen(g_lock_path,"r");
 		if(f == NULL) {
-			f = fopen(buffer,"w");
+			f = fopen(g_lock_path,"w");
+			if (f == NULL) {
+				printf("error cannot open lock file '%s'\n", g_lock_path);
+				return __LINE__;
+			}
 			fputc('!',f);
 			fclose(f);
-			return;
+			break;
 		} else {
 			fclose(f);
+			if (g_lock_timeout > 0 && time(NULL) - t0 >= g_lock_timeout) {
+				printf("error gave up waiting for the lock '%s' after %ld ms\n",
+					g_lock_path, (long)(time(NULL) - t0) * 1000);
+				return __LINE__;
+			}
 			if(!warned) {
 				printf("sleeping until %s is removed",
-					buffer);
-				/*
-				puts("sleeping until " LFILE " is removed");
-				*/
+					g_lock_path);
 				warned=1;
 			}
 			the_sleep(1);
 		}
 	}
+	g_lock_wait_ms = (long)(time(NULL) - t0) * 1000;
+	g_lock_wait_total_ms += g_lock_wait_ms;
+	g_locked_at_ms = now_ms();
+	return 0;
 }
-void unlock(void/*const char *fname*/) {
-	remove(buffer);
+static void unlock(void/*const char *fname*/) {
+	/*--only remove it if it is ours--*/
+	if (g_locked_at_ms >= 0) {
+		remove(g_lock_path);
+		g_lock_held_ms += now_ms() - g_locked_at_ms;
+		g_locked_at_ms = -1;
+	}
 }
 #endif
+#endif
 
 
-int g_je_line = 0;
-char g_je_filename[20];
-char* g_je_vars[256];
-void je_clear_vars(void) {
+static int g_je_line = 0;
+static char g_je_filename[20];
+static char* g_je_vars[256];
+static void je_clear_vars(void) {
 	int i;
 	for (i = 0; i < 256; ++i) {
 		if (g_je_vars[i] != NULL) {
@@ -218,7 +565,7 @@ void je_clear_vars(void) {
 		}
 	}
 }
-void je_setvar(char varletter, const char* varValue, int opt_len) {
+static void je_setvar(char varletter, const char* varValue, int opt_len) {
 	unsigned char uc = (unsigned char)varletter;
 	int i = uc;
 	if (opt_len < 0) {
@@ -230,13 +577,13 @@ void je_setvar(char varletter, const char* varValue, int opt_len) {
 	g_je_vars[i] = malloc(opt_len + 1);
 	if (g_je_vars[i] == NULL) {
 		printf("failed to allocate %d bytes\n",opt_len);
-		exit(__LINE__);
+		give_up(__LINE__);
 	}
 	memcpy(g_je_vars[i], varValue, opt_len);
 	g_je_vars[i][opt_len] = '\0';
 }
-const char* emptyString = "";
-const char* je_getvar(char varLetter) {
+static const char* emptyString = "";
+static const char* je_getvar(char varLetter) {
 	unsigned char uc = (unsigned char)varLetter;
 	int i = uc;
 	if (g_je_vars[i] == NULL) {
@@ -246,20 +593,53 @@ const char* je_getvar(char varLetter) {
 		return g_je_vars[i];
 	}
 }
+/*--where james_expand() writes a line that it changed, grown as
+needed and kept for the next line--*/
+static char* g_je_out = NULL;
+static int g_je_out_cap = 0;
 /**
-@param linebuf
-if it starts with an at-sign, then it is at-sign, filename-override, colon, linenumber-override, dollar sign, then text.
+Appends to g_je_out, making room first.
+@param w
+how much of g_je_out is in use, moved past what was added
+*/
+static void je_out_put(int* w, const char* s, int n) {
+	if (*w + n + 1 > g_je_out_cap) {
+		char* grown;
+		int cap = g_je_out_cap > 0 ? g_je_out_cap : 256;
+		while (cap < *w + n + 1) {
+			cap *= 2;
+		}
+		grown = realloc(g_je_out, cap);
+		if (grown == NULL) {
+			printf("failed to allocate %d bytes\n", cap);
+			give_up(__LINE__);
+		}
+		g_je_out = grown;
+		g_je_out_cap = cap;
+	}
+	memcpy(&g_je_out[*w], s, n);
+	*w += n;
+	g_je_out[*w] = '\0';
+}
+/**
+@param s
+the line, a slice of it rather than a string. If it starts with an at-sign, then it is at-sign, filename-override, colon, linenumber-override, dollar sign, then text.
 Else it is just text. Within text, at-sign is replaced with filename, hash sign is replaced with line number.
 @everynms.h:18$EVERYNMS_INSTANCE_@_#
+On return s and len are moved past any override, or point into
+g_je_out when something was replaced, good until the next call.
+@param len
+how many characters s has
 @param opt_modedfname
 if not null and linebuf had an override, this will store what that override was, must already be allocated
 @param opt_modedlineno
 If not null and linebuf had a line override, this will store what the line override was
 */
-void james_expand(char* linebuf,char *opt_modedfname, int *opt_modedlineno) {
-	char temp[300];
-	char* writeToThis = linebuf;
-	int r, w;
+static void james_expand(const char** s, int* len, char *opt_modedfname, int *opt_modedlineno) {
+	const char* linebuf = *s;
+	int n = *len;
+	int r;
+	int w = 0;
 	int coped = 0;
 	char mod_filename[sizeof g_je_filename];
 	int saved_line = -1;
@@ -267,10 +647,10 @@ void james_expand(char* linebuf,char *opt_modedfname, int *opt_modedlineno) {
 	int saved = 0;
 	int beenxed = 0;
 
-	if (linebuf[0] == '@') {
+	if (n > 0 && linebuf[0] == '@') {
 		int x;
 		/*--attempt to read--*/
-		for (x = 0; x < 100 && linebuf[x] != '\0'; ++x) {
+		for (x = 0; x < 100 && x < n && linebuf[x] != '\0'; ++x) {
 			if (linebuf[x] == ':') {
 				beenxed = x;
 				memcpy(saved_filename, g_je_filename,
@@ -286,20 +666,22 @@ void james_expand(char* linebuf,char *opt_modedfname, int *opt_modedlineno) {
 				}
 			}
 			else if (beenxed && linebuf[x] == '$') {
-				char* num = &linebuf[beenxed + 1];
+				/*--the '$' stops strtol() within the slice--*/
+				const char* num = &linebuf[beenxed + 1];
 				saved_line = g_je_line;
 				g_je_line = strtol(num, NULL, 10);
 				/*--advance pointer and continue--*/
 				linebuf = &linebuf[x + 1];
+				n -= x + 1;
 				break;
 			}
 		}
 	}
-	for (r = 0; r < (int)strlen(linebuf); ++r) {
+	for (r = 0; r < n; ++r) {
 		int isARealVar = 0;
 		const char* str = NULL;
 		if (linebuf[r] == '$') {
-			str = je_getvar(linebuf[r + 1]);
+			str = je_getvar(r + 1 < n ? linebuf[r + 1] : '\0');
 			if (strlen(str) > 0) {
 				isARealVar = 1;
 			}
@@ -317,48 +699,33 @@ void james_expand(char* linebuf,char *opt_modedfname, int *opt_modedlineno) {
 				}
 				mod_filename[h] = '\0';
 				coped = 1;
-				memcpy(temp, linebuf, r);
-				w = r;
+				w = 0;
+				je_out_put(&w, linebuf, r);
 			}
 			if (linebuf[r] == '@') {
-				memcpy(&temp[w], mod_filename, strlen(mod_filename));
-				w += strlen(mod_filename);
+				je_out_put(&w, mod_filename, (int)strlen(mod_filename));
 			}
 			else if (linebuf[r] == '#') {
 				char itoabuf[30];
 				sprintf(itoabuf, "%d", g_je_line);
-				memcpy(&temp[w], itoabuf, strlen(itoabuf));
-				w += strlen(itoabuf);
+				je_out_put(&w, itoabuf, (int)strlen(itoabuf));
 			}
 			else if (linebuf[r] == '$' && isARealVar) {
-				if (w + strlen(str) < sizeof temp) {
-					memcpy(&temp[w], str, strlen(str)+1);
-					w += strlen(str);
-				}
-				else {
-					printf("ran out of temp space with %s and %s\n", temp, str);
-					exit(__LINE__);
-				}
+				je_out_put(&w, str, (int)strlen(str));
 				++r;
 			}
 		}
 		else if (coped) {
-			temp[w] = linebuf[r];
-			++w;
+			je_out_put(&w, &linebuf[r], 1);
 		}
 	}
 	if (coped) {
-		int n;
-		temp[w] = '\0';
-		n = strlen(temp);
-		if (n > LINEBUF_LEN - 1) {
-			n = LINEBUF_LEN - 1;
-		}
-		memcpy(writeToThis, temp, n);
-		writeToThis[n] = '\0';
+		*s = g_je_out;
+		*len = w;
 	}
-	else if (beenxed) {
-		memmove(writeToThis, linebuf, strlen(linebuf) + 1);
+	else {
+		*s = linebuf;
+		*len = n;
 	}
 	if (saved) {
 		if (opt_modedfname != NULL) {
@@ -397,8 +764,8 @@ struct list_item {
 	struct list_item *next;
 };
 
-struct list * first_list;
-void apply_listitem_fn_ln(struct list_item* x, const char* opt_fn, const int* opt_ln) {
+static struct list * first_list;
+static void apply_listitem_fn_ln(struct list_item* x, const char* opt_fn, const int* opt_ln) {
 	if (opt_fn != NULL && opt_fn[0] != '\0') {
 		memcpy(x->fname, opt_fn,
 			strlen(opt_fn) + 1);
@@ -414,9 +781,18 @@ void apply_listitem_fn_ln(struct list_item* x, const char* opt_fn, const int* op
 		x->lineno = g_je_line;
 	}
 }
-void add_list_item(const char* listname, const char* value,
-	const char *opt_fn, const int *opt_ln){
+/**
+@param value
+the item, need not be null terminated when opt_valuelen is given
+@param opt_valuelen
+how many characters value has, -1 for all of it
+*/
+static void add_list_item(const char* listname, const char* value,
+	int opt_valuelen, const char *opt_fn, const int *opt_ln){
 	struct list * x;
+	if (opt_valuelen < 0) {
+		opt_valuelen = (int)strlen(value);
+	}
 	x = first_list;
 	/*--initial insert in total--*/
 	if (x == NULL) {
@@ -424,14 +800,14 @@ void add_list_item(const char* listname, const char* value,
 		if (first_list == NULL) {
 			printf("failed to malloc\n");
 			unlock();
-			exit(__LINE__);
+			give_up(__LINE__);
 		}
 		first_list->next_list = NULL;
 		first_list->name = malloc(strlen(listname) + 1);
 		if (first_list->name == NULL) {
 			printf("failed to malloc\n");
 			unlock();
-			exit(__LINE__);
+			give_up(__LINE__);
 		}
 		memcpy(first_list->name, listname,
 			strlen(listname) + 1);
@@ -439,17 +815,17 @@ void add_list_item(const char* listname, const char* value,
 		if (first_list->head == NULL) {
 			printf("failed to malloc\n");
 			unlock();
-			exit(__LINE__);
+			give_up(__LINE__);
 		}
 		first_list->head->next = NULL;
-		first_list->head->value = malloc(strlen(value) + 1);
+		first_list->head->value = malloc(opt_valuelen + 1);
 		if (first_list->head->value == NULL) {
 			printf("failed to malloc\n");
 			unlock();
-			exit(__LINE__);
+			give_up(__LINE__);
 		}
-		memcpy(first_list->head->value, value,
-			strlen(value) + 1);
+		memcpy(first_list->head->value, value, opt_valuelen);
+		first_list->head->value[opt_valuelen] = '\0';
 		/*--apply the filename and linenumber--*/
 		apply_listitem_fn_ln(first_list->head, opt_fn, opt_ln);
 		
@@ -465,16 +841,16 @@ void add_list_item(const char* listname, const char* value,
 				if (x->head == NULL) {
 					printf("failed to malloc\n");
 					unlock();
-					exit(__LINE__);
+					give_up(__LINE__);
 				}
-				x->head->value = malloc(strlen(value)+1);
+				x->head->value = malloc(opt_valuelen + 1);
 				if (x->head->value == NULL) {
 					printf("failed to malloc\n");
 					unlock();
-					exit(__LINE__);
+					give_up(__LINE__);
 				}
-				memcpy(x->head->value,value,strlen(value)
-					+1);
+				memcpy(x->head->value, value, opt_valuelen);
+				x->head->value[opt_valuelen] = '\0';
 				/*memcpy(x->head->fname, g_je_filename,
 					strlen(g_je_filename) + 1);
 				x->head->lineno = g_je_line;*/
@@ -487,7 +863,8 @@ void add_list_item(const char* listname, const char* value,
 				while(1) {
 					
 					if(y->value == NULL
-						|| strcmp(y->value,value)==0) {
+						|| (strlen(y->value) == (size_t)opt_valuelen
+							&& memcmp(y->value, value, opt_valuelen) == 0)) {
 						/*--item already exists--*/
 						return;
 					}
@@ -498,17 +875,17 @@ void add_list_item(const char* listname, const char* value,
 						if (y->next == NULL) {
 							printf("failed to malloc\n");
 							unlock();
-							exit(__LINE__);
+							give_up(__LINE__);
 						}
-						y->next->value = malloc(strlen(value)
+						y->next->value = malloc(opt_valuelen
 							+1);
 						if (y->next->value == NULL) {
 							printf("failed to malloc\n");
 							unlock();
-							exit(__LINE__);
+							give_up(__LINE__);
 						}
-						memcpy(y->next->value,value,
-							strlen(value)+1);
+						memcpy(y->next->value, value, opt_valuelen);
+						y->next->value[opt_valuelen] = '\0';
 						apply_listitem_fn_ln(y->next, opt_fn, opt_ln);
 						/*
 						memcpy(y->next->fname, g_je_filename,
@@ -529,14 +906,14 @@ void add_list_item(const char* listname, const char* value,
 				if (x->next_list == NULL) {
 					printf("failed to malloc\n");
 					unlock();
-					exit(__LINE__);
+					give_up(__LINE__);
 				}
 				x->next_list->name = malloc(strlen(listname)
 					+1);
 				if (x->next_list->name == NULL) {
 					printf("failed to malloc\n");
 					unlock();
-					exit(__LINE__);
+					give_up(__LINE__);
 				}
 				memcpy(x->next_list->name,listname,
 				 strlen(listname)+1);
@@ -549,7 +926,8 @@ void add_list_item(const char* listname, const char* value,
 	}
 }
 
-void shuffle_trim(char *linebuf) {
+#ifndef JAMES_NO_MAIN
+static void shuffle_trim(char *linebuf) {
 	int i=0;
 	while(isspace(linebuf[i])
 		&& linebuf[i] != '\0') {
@@ -570,25 +948,77 @@ void shuffle_trim(char *linebuf) {
 		}
 	}
 }
+#endif
+/**
+Trims a slice of a line like shuffle_trim() does a string, only
+by moving its bounds rather than the characters.
+*/
+static void slice_trim(const char** s, int* len) {
+	while (*len > 0 && isspace((*s)[0])) {
+		++*s;
+		--*len;
+	}
+	while (*len > 0 && isspace((*s)[*len - 1])) {
+		--*len;
+	}
+}
+/**
+@return
+how much of a slice of a line comes before any '\0' in it, as a
+'\0' ends a line the same as it ends a string
+*/
+static int slice_cut(const char* s, int len) {
+	const char* z = memchr(s, '\0', len);
+	return z != NULL ? (int)(z - s) : len;
+}
+/**
+@return
+what strtol() would make of the start of a slice of a line,
+without reading past its end
+*/
+static long slice_strtol(const char* s, int len) {
+	long n = 0;
+	int neg = 0;
+	int i = 0;
+	while (i < len && isspace(s[i])) {
+		++i;
+	}
+	if (i < len && (s[i] == '-' || s[i] == '+')) {
+		neg = s[i] == '-';
+		++i;
+	}
+	while (i < len && isdigit(s[i])) {
+		n = n * 10 + (s[i] - '0');
+		++i;
+	}
+	return neg ? -n : n;
+}
 
 
 /*--must be rest on exit line_is_james--*/
-int g_jatl_i=0;
-char g_jatl_listname[50];
-void JAMES_ADD_TO_LIST(char *linebuf){
-	shuffle_trim(linebuf);
+static int g_jatl_i=0;
+static char g_jatl_listname[50];
+/**
+@param linebuf
+a line of the james command, a slice of the source rather than a
+string, see parse_buf()
+@param len
+how many characters it has
+*/
+static void JAMES_ADD_TO_LIST(const char *linebuf, int len){
+	slice_trim(&linebuf, &len);
 	switch(g_jatl_i){
 
 			
 		case 0:
-			james_expand(linebuf,NULL,NULL);
-			if(strlen(linebuf) 
-				> (sizeof g_jatl_listname ) - 1) {
-				printf("error %s is too long a list name\n",
-					linebuf);
+			james_expand(&linebuf, &len, NULL, NULL);
+			if(len 
+				> (int)(sizeof g_jatl_listname ) - 1) {
+				printf("error %.*s is too long a list name\n",
+					len, linebuf);
 			} else {
-				memcpy(g_jatl_listname, linebuf,
-					strlen(linebuf) + 1);
+				memcpy(g_jatl_listname, linebuf, len);
+				g_jatl_listname[len] = '\0';
 			}
 			break;
 			
@@ -596,8 +1026,8 @@ void JAMES_ADD_TO_LIST(char *linebuf){
 		{
 			int ln;
 			char fn[sizeof g_je_filename];
-			james_expand(linebuf,&fn[0],&ln);
-			add_list_item(g_jatl_listname, linebuf,&fn[0],&ln);
+			james_expand(&linebuf, &len, &fn[0], &ln);
+			add_list_item(g_jatl_listname, linebuf, len, &fn[0], &ln);
 		}
 			
 			break;
@@ -623,22 +1053,24 @@ struct alias_plus {
 	char** alsoPlus;
 	char* define_output_name;
 	struct alias_plus_macroline* macro_lines;
+	/*--the next one with the same hash, see alias_plus_buckets--*/
+	struct alias_plus* next_in_bucket;
 };
 /*
-void fail2malloc(void *p,long line) {
+static void fail2malloc(void *p,long line) {
 	if (p == NULL) {
 		puts("failed to malloc");
-		exit(__LINE__);
+		give_up(__LINE__);
 	}
 }*/
-const char* f2m_str = "failed to malloc";
+static const char* f2m_str = "failed to malloc";
 #define fail2malloc(p,line) \
 if (p == NULL) { \
 	puts(f2m_str); \
-	exit(__LINE__); \
+	give_up(__LINE__); \
 }
-struct alias_plus* alias_plus_head = NULL;
-struct alias_plus* alias_plus_newx(const char* name, int len) {
+static struct alias_plus* alias_plus_head = NULL;
+static struct alias_plus* alias_plus_newx(const char* name, int len) {
 	struct alias_plus* x;
 	x = malloc(sizeof (struct alias_plus));
 	fail2malloc(x, __LINE__);
@@ -653,10 +1085,37 @@ struct alias_plus* alias_plus_newx(const char* name, int len) {
 	x->alsoPlus = NULL;
 	x->define_output_name = NULL;
 	x->macro_lines = NULL;
+	x->next_in_bucket = NULL;
 	return x;
 }
-struct alias_plus* alias_plus_get(const char* name, int len);
-void alias_plus_addline(const char* name, int len, const char *line, int linelen) {
+#define ALIAS_BUCKETS 256
+/*--alias_plus_get() looks a name up here rather than going down
+the whole list, it is made from the list the first time it is
+needed and then kept up to date until james_state_clear()--*/
+static struct alias_plus** alias_plus_buckets = NULL;
+static unsigned int alias_plus_hash(const char* name, int len) {
+	unsigned int h = 5381;
+	int i;
+	for (i = 0; i < len; ++i) {
+		h = h * 33 + (unsigned char)name[i];
+	}
+	return h % ALIAS_BUCKETS;
+}
+/**
+Puts x in alias_plus_buckets, after any with the same hash so
+that the first one in the list is still the one found.
+*/
+static void alias_plus_index_add(struct alias_plus* x) {
+	struct alias_plus** at = &alias_plus_buckets[
+		alias_plus_hash(x->name, (int)strlen(x->name))];
+	while (*at != NULL) {
+		at = &(*at)->next_in_bucket;
+	}
+	x->next_in_bucket = NULL;
+	*at = x;
+}
+static struct alias_plus* alias_plus_get(const char* name, int len);
+static void alias_plus_addline(const char* name, int len, const char *line, int linelen) {
 	struct alias_plus* x = alias_plus_get(name, len);
 	struct alias_plus_macroline* z;
 	if (x == NULL) {
@@ -686,47 +1145,56 @@ void alias_plus_addline(const char* name, int len, const char *line, int linelen
 	}
 
 }
-void alias_plus_new(const char* name, int len) {
+static void alias_plus_new(const char* name, int len) {
 	if (len == -1) {
 		len = strlen(name);
 	}
 	if (alias_plus_head == NULL) {
 		alias_plus_head = alias_plus_newx(name, len);
+		if (alias_plus_buckets != NULL) {
+			alias_plus_index_add(alias_plus_head);
+		}
 	}
 	else {
 		struct alias_plus* x = alias_plus_head;
-		while (x != NULL) {
-			if (strlen(x->name)==len
-				&& strncmp(x->name, name, len) == 0) {
-				return;
-			}
-			if (x->next == NULL) {
-				x->next = alias_plus_newx(name, len);
-				return;
-			}
+		if (alias_plus_get(name, len) != NULL) {
+			return;
+		}
+		while (x->next != NULL) {
 			x = x->next;
 		}
+		x->next = alias_plus_newx(name, len);
+		if (alias_plus_buckets != NULL) {
+			alias_plus_index_add(x->next);
+		}
 	}
 }
-struct alias_plus * alias_plus_get(const char* name, int len) {
+static struct alias_plus * alias_plus_get(const char* name, int len) {
 	struct alias_plus* x = NULL;
 	if (len == -1) {
 		len = strlen(name);
 	}
-	x = alias_plus_head;
+	if (alias_plus_head == NULL) {
+		return NULL;
+	}
+	if (alias_plus_buckets == NULL) {
+		alias_plus_buckets = calloc(ALIAS_BUCKETS, sizeof *alias_plus_buckets);
+		fail2malloc(alias_plus_buckets, __LINE__);
+		for (x = alias_plus_head; x != NULL; x = x->next) {
+			alias_plus_index_add(x);
+		}
+	}
+	x = alias_plus_buckets[alias_plus_hash(name, len)];
 	while (x != NULL) {
 		if (strlen(x->name)==len 
 			&& strncmp(x->name, name, len) == 0) {
 			return x;
 		}
-		if (x->next == NULL) {
-			return NULL;
-		}
-		x = x->next;
+		x = x->next_in_bucket;
 	}
 	return NULL;
 }
-void alias_plus_define_positional(const char* name, int len, char varLetter) {
+static void alias_plus_define_positional(const char* name, int len, char varLetter) {
 	struct alias_plus* x = alias_plus_get(name,len);
 	struct alias_positional* y = NULL;
 	int pos;
@@ -767,7 +1235,7 @@ void alias_plus_define_positional(const char* name, int len, char varLetter) {
 
 	x->numPositionals = pos;
 }
-void alias_plus_free_macrolines(struct alias_plus_macroline* head) {
+static void alias_plus_free_macrolines(struct alias_plus_macroline* head) {
 	struct alias_plus_macroline* next;
 	while (head != NULL) {
 		next = head->next;
@@ -783,8 +1251,8 @@ struct ap_invocation {
 	char** argv;
 	struct ap_invocation* next;
 };
-struct ap_invocation* ap_inv_head = NULL;
-struct ap_invocation* ap_inv_create(const char* name, int opt_namelen) {
+static struct ap_invocation* ap_inv_head = NULL;
+static struct ap_invocation* ap_inv_create(const char* name, int opt_namelen) {
 	struct ap_invocation* ret;
 	if (opt_namelen < 0) {
 		opt_namelen = (int)strlen(name);
@@ -797,10 +1265,11 @@ struct ap_invocation* ap_inv_create(const char* name, int opt_namelen) {
 	ret->next = NULL;
 	ret->name = malloc(opt_namelen + 1);
 	fail2malloc(ret->name,__LINE__);
-	memcpy(ret->name, name, opt_namelen + 1);
+	memcpy(ret->name, name, opt_namelen);
+	ret->name[opt_namelen] = '\0';
 	return ret;
 }
-int ap_inv_testifalready(struct ap_invocation* ap) {
+static int ap_inv_testifalready(struct ap_invocation* ap) {
 	struct ap_invocation* x = ap_inv_head;
 	while (x != NULL) {
 		if (strcmp(ap->name, x->name) == 0) {
@@ -826,7 +1295,7 @@ int ap_inv_testifalready(struct ap_invocation* ap) {
 	}
 	return 0;
 }
-void ap_inv_free(struct ap_invocation* in) {
+static void ap_inv_free(struct ap_invocation* in) {
 	struct ap_invocation* nex = NULL;
 	while (in != NULL) {
 		if (in->name != NULL) {
@@ -855,13 +1324,36 @@ void ap_inv_free(struct ap_invocation* in) {
 		in = nex;
 	}
 }
+/*--everything held in ram for one james.h, so that more than
+one can be held at once and swapped in and out, see --daemon--*/
+struct james_state {
+	struct list* first_list;
+	struct alias_plus* alias_plus_head;
+	struct alias_plus** alias_plus_buckets;
+	struct ap_invocation* ap_inv_head;
+};
+static void james_state_save(struct james_state* st) {
+	st->first_list = first_list;
+	st->alias_plus_head = alias_plus_head;
+	st->alias_plus_buckets = alias_plus_buckets;
+	st->ap_inv_head = ap_inv_head;
+}
+static void james_state_load(const struct james_state* st) {
+	first_list = st->first_list;
+	alias_plus_head = st->alias_plus_head;
+	alias_plus_buckets = st->alias_plus_buckets;
+	ap_inv_head = st->ap_inv_head;
+}
 /*--must be rest on exit line_is_james--*/
-int g_jiap_i = 0;
-int g_jiap_argno = 0;
+static int g_jiap_i = 0;
+static int g_jiap_argno = 0;
 //char g_jiap_aliasname[100];
 //int g_jiap_aliaslen = 0;
-struct ap_invocation* g_jiap_apinv = NULL;
-void JAMES_INVOKE_ALIAS_PLUS(char* linebuf) {
+static struct ap_invocation* g_jiap_apinv = NULL;
+/**
+Same as JAMES_ADD_TO_LIST() for its own command.
+*/
+static void JAMES_INVOKE_ALIAS_PLUS(const char* linebuf, int len) {
 	switch (g_jiap_i) {
 	case 0:
 		g_jiap_argno = 0;
@@ -869,20 +1361,20 @@ void JAMES_INVOKE_ALIAS_PLUS(char* linebuf) {
 			ap_inv_free(g_jiap_apinv);
 			g_jiap_apinv = NULL;
 		}
-		shuffle_trim(linebuf);
+		slice_trim(&linebuf, &len);
 		/*g_jiap_aliaslen = strlen(linebuf);
 		if (g_jiap_aliaslen > sizeof g_jiap_aliasname-1) {
 			g_jiap_aliaslen = sizeof g_jiap_aliasname-1;
 		}
 		memcpy(g_jiap_aliasname, linebuf, g_jiap_aliaslen);
 		g_jiap_aliasname[g_jiap_aliaslen] = '\0';*/
-		g_jiap_apinv = ap_inv_create(linebuf, -1);
+		g_jiap_apinv = ap_inv_create(linebuf, len);
 			break;
 	case 1:
 	{
 		char expander[sizeof g_je_filename];
 		int expanded;
-		james_expand(linebuf, &expander[0], &expanded);
+		james_expand(&linebuf, &len, &expander[0], &expanded);
 		g_jiap_apinv->lineno = expanded;
 		g_jiap_apinv->fname = malloc(strlen(expander) + 1);
 		fail2malloc(g_jiap_apinv->fname,__LINE__);
@@ -890,7 +1382,7 @@ void JAMES_INVOKE_ALIAS_PLUS(char* linebuf) {
 	}
 		break;
 	case 2:
-		g_jiap_apinv->argc = strtol(linebuf, NULL, 10);
+		g_jiap_apinv->argc = slice_strtol(linebuf, len);
 		if (g_jiap_apinv->argc < 0) {
 			genericDie(__LINE__);
 		}
@@ -904,10 +1396,11 @@ void JAMES_INVOKE_ALIAS_PLUS(char* linebuf) {
 				g_jiap_apinv->argc, g_jiap_argno, g_jiap_apinv->name, g_jiap_apinv->fname, g_jiap_apinv->lineno);
 			genericDie(__LINE__);
 		}
-		shuffle_trim(linebuf);
-		g_jiap_apinv->argv[g_jiap_argno] = malloc(strlen(linebuf)+1);
+		slice_trim(&linebuf, &len);
+		g_jiap_apinv->argv[g_jiap_argno] = malloc(len + 1);
 		fail2malloc(g_jiap_apinv->argv[g_jiap_argno],__LINE__);
-		memcpy(g_jiap_apinv->argv[g_jiap_argno], linebuf, strlen(linebuf) + 1);
+		memcpy(g_jiap_apinv->argv[g_jiap_argno], linebuf, len);
+		g_jiap_apinv->argv[g_jiap_argno][len] = '\0';
 		++g_jiap_argno;
 
 		if (g_jiap_argno == g_jiap_apinv->argc) {
@@ -935,12 +1428,18 @@ void JAMES_INVOKE_ALIAS_PLUS(char* linebuf) {
 	g_jiap_i = g_jiap_i + 1;
 }
 /*--must be rest on exit line_is_james--*/
-int g_jap_i = 0;
-int g_jap_plusnum = 0;
-int g_jap_plus_i = 0;
-char g_jap_aliasname[100];
-int g_jap_aliaslen=0;
-void JAMES_ALIAS_PLUS(char* linebuf) {
+static int g_jap_i = 0;
+static int g_jap_plusnum = 0;
+static int g_jap_plus_i = 0;
+/*--the name of the alias_plus being defined, g_jap_aliaslen long,
+grown to fit as names have no limit--*/
+static char* g_jap_aliasname = NULL;
+static int g_jap_aliasname_cap = 0;
+static int g_jap_aliaslen=0;
+/**
+Same as JAMES_ADD_TO_LIST() for its own command.
+*/
+static void JAMES_ALIAS_PLUS(const char* linebuf, int len) {
 	
 	switch (g_jap_i) {
 	case 3:
@@ -949,10 +1448,11 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 		if (x == NULL) {
 			genericDie(__LINE__);
 		}
-		shuffle_trim(linebuf);
-		x->define_output_name = malloc(strlen(linebuf) + 1);
+		slice_trim(&linebuf, &len);
+		x->define_output_name = malloc(len + 1);
 		fail2malloc(x->define_output_name, __LINE__);
-		memcpy(x->define_output_name, linebuf, strlen(linebuf) + 1);
+		memcpy(x->define_output_name, linebuf, len);
+		x->define_output_name[len] = '\0';
 
 		/*--we have to clear all macro lines or it will just add up?--*/
 		alias_plus_free_macrolines(x->macro_lines);
@@ -968,11 +1468,11 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 		if (x == NULL) {
 			genericDie(__LINE__);
 		}
-		x->alsoPlus[g_jap_plus_i] = malloc(strlen(linebuf) + 1);
+		slice_trim(&linebuf, &len);
+		x->alsoPlus[g_jap_plus_i] = malloc(len + 1);
 		fail2malloc(x->alsoPlus[g_jap_plus_i], __LINE__);
-		memcpy(x->alsoPlus[g_jap_plus_i], linebuf, strlen(linebuf));
-		x->alsoPlus[g_jap_plus_i][strlen(linebuf)] = '\0';
-		shuffle_trim(x->alsoPlus[g_jap_plus_i]);
+		memcpy(x->alsoPlus[g_jap_plus_i], linebuf, len);
+		x->alsoPlus[g_jap_plus_i][len] = '\0';
 	}
 		++g_jap_plus_i;
 		if (g_jap_plus_i < g_jap_plusnum) {
@@ -981,7 +1481,7 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 		}
 		break;
 	case 1:
-		g_jap_plusnum = (int)strtol(linebuf, NULL, 10);
+		g_jap_plusnum = (int)slice_strtol(linebuf, len);
 		if (g_jap_plusnum < 0) {
 			genericDie(__LINE__);
 		}
@@ -998,7 +1498,6 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 		break;
 	case 0:
 		g_jap_plusnum = 0;
-		g_jap_aliasname[0]='\0';
 		g_jap_aliaslen = 0;
 		je_clear_vars();
 	{
@@ -1006,7 +1505,7 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 		int varPositional = 1;
 		int posOfOpenParen;
 		int startlen=0;
-		for (posOfOpenParen = 0; posOfOpenParen < (int)strlen(linebuf); posOfOpenParen++) {
+		for (posOfOpenParen = 0; posOfOpenParen < len; posOfOpenParen++) {
 			if (linebuf[posOfOpenParen] == '(') {
 				startlen = posOfOpenParen;
 				while (start[0] != '(' && start[0] != '\0' 
@@ -1015,39 +1514,43 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 					--startlen;
 				}
 				alias_plus_new(start, startlen);
-				if (startlen+1 > sizeof g_jap_aliasname) {
-					printf("alias %s is too long\n", start);
-					exit(__LINE__);
+				if (startlen + 1 > g_jap_aliasname_cap) {
+					char* grown = realloc(g_jap_aliasname, startlen + 1);
+					fail2malloc(grown, __LINE__);
+					g_jap_aliasname = grown;
+					g_jap_aliasname_cap = startlen + 1;
 				}
 				memcpy(g_jap_aliasname, start, startlen);
-				g_jap_aliasname[startlen + 1] = '\0';
+				g_jap_aliasname[startlen] = '\0';
 				g_jap_aliaslen = startlen;
 //				alias_plus_new(linebuf, posOfOpenParen);
 				break;
 			}
 		}
-		if (posOfOpenParen < (int)strlen(linebuf)) {
+		if (posOfOpenParen < len) {
 			int i = posOfOpenParen;
-			while (i < (int)strlen(linebuf)) {
+			while (i < len) {
 				char val;
-				while (linebuf[i] != '$'
+				while (i < len
+					&& linebuf[i] != '$'
 					&& linebuf[i] != ')'
 					&& linebuf[i] != '\0') {
 					++i;
 				}
-				val = linebuf[i];
+				val = i < len ? linebuf[i] : '\0';
 				if (val == ')') {
 					break;
 				}
 				++i;
-				val = linebuf[i];
+				val = i < len ? linebuf[i] : '\0';
 				if (val == ')') {
 					break;
 				}
 
 				alias_plus_define_positional(start, startlen, val);
 
-				while (linebuf[i] != ','
+				while (i < len
+					&& linebuf[i] != ','
 					&& linebuf[i] != ')'
 					&& linebuf[i] != '\0') {
 					++i;
@@ -1058,16 +1561,16 @@ void JAMES_ALIAS_PLUS(char* linebuf) {
 		break;
 	default:
 
-		shuffle_trim(linebuf);
-		alias_plus_addline(g_jap_aliasname, g_jap_aliaslen, linebuf, strlen(linebuf));
+		slice_trim(&linebuf, &len);
+		alias_plus_addline(g_jap_aliasname, g_jap_aliaslen, linebuf, len);
 
 		break;
 	}
 	g_jap_i = g_jap_i + 1;
 }
 
-const char* headerfile_footer = "\n#endif /*james_h*/\n";
-const char *header = "/**@file james.h\n\
+static const char* headerfile_footer = "\n#endif /*james_h*/\n";
+static const char *header = "/**@file james.h\n\
 @brief externally generated header from \"james\" program\n\
 \n\
 \n\
@@ -1182,15 +1685,15 @@ Ensure that the QUOTE() macro is defined as well\n\
 #endif\n\
 \n\
 \n";
-const char * s_generated_list = "/** Generated List ";
-const char * s_startlist_define = "#define ";
-int jchashchar(int sum, char c) {
+static const char * s_generated_list = "/** Generated List ";
+static const char * s_startlist_define = "#define ";
+static int jchashchar(int sum, char c) {
 	if (isalnum(c)) {
 		return sum + c;
 	}
 	return sum;
 }
-int jchash(const char *str){
+static int jchash(const char *str){
 	int i;
 	int h=0;
 	for(i=0;i<(int)strlen(str);++i){
@@ -1200,36 +1703,115 @@ int jchash(const char *str){
 	return h;
 }
 
-struct alias_plus* g_tiap_ap = NULL;
-int test_invocate_alias_plus(const char* linebuf) {
+/**
+Tests if the line looks like it calls an alias_plus, that is
+it starts with a letter and has an open and a close paren.
+@param linebuf
+the line so far
+@param len
+how many characters it has
+@param startlen
+will store how long the name before the open paren is
+@return
+the start of the name, or NULL if it does not look like a call
+*/
+static const char* alias_call_name(const char* linebuf, int len, int *startlen) {
+	const char* const end = linebuf + len;
 	const char* start = linebuf;
 	const char* openParen = NULL;
 	const char* closeParen = NULL;
-	while (start[0] != '\0' && isspace(start[0])) {
+	while (start < end && start[0] != '\0' && isspace(start[0])) {
 		start++;
 	}
 	openParen = start;
-	while (openParen[0] != '\0' && openParen[0]!='(') {
+	while (openParen < end && openParen[0] != '\0' && openParen[0]!='(') {
 		openParen++;
 	}
 	closeParen = openParen;
-	while (closeParen[0] != '\0' && closeParen[0] != ')') {
+	while (closeParen < end && closeParen[0] != '\0' && closeParen[0] != ')') {
 		closeParen++;
 	}
-	if (isalpha(start[0]) 
+	if (closeParen < end
+		&& isalpha(start[0]) 
 		&& openParen[0] == '(' 
 		&& closeParen[0] == ')') {
-		int startlen = openParen - start;
-		struct alias_plus* ap = alias_plus_get(start, startlen);
-		if (ap != NULL) {
-			g_tiap_ap = ap;
-			return 1;
+		*startlen = openParen - start;
+		return start;
+	}
+	return NULL;
+}
+/*--the alias_plus that call_alias_plus() is to call--*/
+static struct alias_plus* g_tiap_ap = NULL;
+/*--follows what alias_call_name() and alias_plus_get() would say
+about a line as it grows, looking at each character only once
+rather than at the whole line after each character--*/
+struct alias_match {
+	/*--where in the line it starts, and how far it has looked--*/
+	int from;
+	int upto;
+	/*--the first non space and the first "(" from there on, -1
+	until there is one--*/
+	int start;
+	int open;
+	/*--a ")" came after the "("--*/
+	int closed;
+	/*--a '\0' in the line hides the rest of it--*/
+	int ended;
+	/*--what the name before the "(" is, if anything--*/
+	struct alias_plus* ap;
+};
+/**
+Starts again from a place in the line, as after the line begins
+or call_alias_plus() has read up to somewhere.
+*/
+static void alias_match_reset(struct alias_match* m, int from) {
+	m->from = from;
+	m->upto = from;
+	m->start = -1;
+	m->open = -1;
+	m->closed = 0;
+	m->ended = 0;
+	m->ap = NULL;
+}
+/**
+Looks at the characters of the line that were added since the
+last time.
+@param linebuf
+the line so far
+@param len
+how many characters it has
+@return
+the alias_plus that the line from where the matching started
+calls, NULL if it does not call one (yet)
+*/
+static struct alias_plus* alias_match_feed(struct alias_match* m,
+	const char* linebuf, int len) {
+	for (; m->upto < len && !m->ended; ++m->upto) {
+		const char c = linebuf[m->upto];
+		if (c == '\0') {
+			m->ended = 1;
+			break;
+		}
+		if (m->start < 0 && !isspace(c)) {
+			m->start = m->upto;
+		}
+		if (m->start >= 0 && m->open < 0) {
+			if (c == '(') {
+				m->open = m->upto;
+				m->ap = NULL;
+				if (isalpha(linebuf[m->start])) {
+					m->ap = alias_plus_get(linebuf + m->start,
+						m->open - m->start);
+				}
+			}
+		}
+		else if (m->open >= 0 && c == ')') {
+			m->closed = 1;
 		}
 	}
-	g_tiap_ap = NULL;
-	return 0;
+	return m->closed ? m->ap : NULL;
 }
-void defered_invoke_alias_plus(const char** varsubs, int num_varsubs, int lineno, const char* fname, struct alias_plus* x)
+static void defered_invoke_alias_plus(const char** varsubs, int num_varsubs, int lineno, const char* fname, struct alias_plus* x)
 {
 	struct ap_invocation* ap_inv = ap_inv_create(x->name, -1);
 	int j;
@@ -1261,7 +1843,7 @@ void defered_invoke_alias_plus(const char** varsubs, int num_varsubs, int lineno
 		ap_inv_free(ap_inv);
 	}
 }
-void ap_inv_applyvars(struct alias_plus* x, const char** varsubs, int num_varsubs, FILE* j, const char *fname, int lineno) {
+static void ap_inv_applyvars(struct alias_plus* x, const char** varsubs, int num_varsubs, FILE* j, const char *fname, int lineno) {
 	int i;
 	struct alias_positional* ps = x->head;
 	je_clear_vars();
@@ -1277,7 +1859,7 @@ void ap_inv_applyvars(struct alias_plus* x, const char** varsubs, int num_varsub
 			}
 			printf(" %s:%d error not enough parameters supplied, we expected %d but only got %d\n",
 				fname, lineno, x->numPositionals, num_varsubs);
-			exit(__LINE__);
+			give_up(__LINE__);
 			return;
 		}
 		je_setvar(ps->varLetter, varsubs[ps->posNum - 1], -1);
@@ -1286,7 +1868,7 @@ void ap_inv_applyvars(struct alias_plus* x, const char** varsubs, int num_varsub
 	
 }
 
-void ap_inv_proc_alsos(struct ap_invocation* z) {
+static void ap_inv_proc_alsos(struct ap_invocation* z) {
 	struct alias_plus* x;
 	int line_jamescmdhash;
 	const int hash_ADDTOLIST = jchash("JAMES_ADD_TO_LIST");
@@ -1310,9 +1892,6 @@ void ap_inv_proc_alsos(struct ap_invocation* z) {
 		int i;
 		char save_fn[sizeof g_je_filename+1];
 		int save_ln;
-		/*--the funcs can modify the lines but we want them to remain--*/
-		char temp[257];
-
 		line_jamescmdhash = jchash(x->alsoPlus[0]);
 		ap_inv_applyvars(x, z->argv, z->argc, NULL,z->fname,z->lineno);
 		memcpy(save_fn, g_je_filename, sizeof g_je_filename);
@@ -1322,20 +1901,17 @@ void ap_inv_proc_alsos(struct ap_invocation* z) {
 		g_je_line = z->lineno;
 		
 		for (i = 1; i < x->alsoPlusNum; ++i) {
-			if (strlen(x->alsoPlus[i]) > sizeof temp - 1) {
-				printf("error,\"%s\" is too long (max %d) (%ld)\n", x->alsoPlus[i], sizeof temp - 1, __LINE__);
-				genericDie(__LINE__);
-				return;
-			}
-			memcpy(temp, x->alsoPlus[i], strlen(x->alsoPlus[i]) + 1);
+			/*--the funcs only move the bounds of the line, so it
+			remains as it is--*/
+			const int len = (int)strlen(x->alsoPlus[i]);
 			if (line_jamescmdhash == hash_ADDTOLIST) {
-				JAMES_ADD_TO_LIST(temp);
+				JAMES_ADD_TO_LIST(x->alsoPlus[i], len);
 			}
 			else if (line_jamescmdhash == hash_ALIASPLUS) {
-				JAMES_ALIAS_PLUS(temp);
+				JAMES_ALIAS_PLUS(x->alsoPlus[i], len);
 			}
 			else if (line_jamescmdhash == hash_INVOKEALIASPLUS) {
-				JAMES_INVOKE_ALIAS_PLUS(temp);
+				JAMES_INVOKE_ALIAS_PLUS(x->alsoPlus[i], len);
 			}
 			else {
 				printf("error, %d is unrecognised hash (%s) (%ld)\n", line_jamescmdhash, x->alsoPlus[0], __LINE__);
@@ -1357,7 +1933,32 @@ void ap_inv_proc_alsos(struct ap_invocation* z) {
 	g_jiap_i = 0;
 
 }
-void ap_inv_render(struct ap_invocation* z, FILE* j) {
+/**
+Runs the alsos of only the alias_plus invocations that were
+added after the given one, so that each source file's alsos
+are run straight after it is parsed.
+@param after
+the last invocation that was already there before, or NULL
+to run them all
+*/
+static void ap_inv_proc_alsos_after(struct ap_invocation* after) {
+	struct ap_invocation* y = ap_inv_head;
+	if (after != NULL) {
+		y = after->next;
+	}
+	while (y != NULL) {
+		ap_inv_proc_alsos(y);
+		y = y->next;
+	}
+}
+static struct ap_invocation* ap_inv_tail(void) {
+	struct ap_invocation* y = ap_inv_head;
+	while (y != NULL && y->next != NULL) {
+		y = y->next;
+	}
+	return y;
+}
+static void ap_inv_render(struct ap_invocation* z, FILE* j) {
 	struct alias_plus* x;
 	int num_varsubs;
 	char** varsubs;
@@ -1382,18 +1983,18 @@ void ap_inv_render(struct ap_invocation* z, FILE* j) {
 	ap_inv_applyvars(x,varsubs,num_varsubs,j,fname,lineno);
 
 	{
-		char temp[350];
+		const char* line = x->define_output_name;
+		int len = (int)strlen(line);
 		char saved[sizeof g_je_filename];
 		int savline;
-		memcpy(temp, x->define_output_name, strlen(x->define_output_name) + 1);
 
 		savline = g_je_line;
 		memcpy(saved, g_je_filename, sizeof g_je_filename);
 		g_je_line = lineno;
 		memcpy(g_je_filename, fname, strlen(fname) + 1);
-		james_expand(temp, NULL, NULL);
-		fprintf(j, "\n/**\ninvocation of alias_plus \"%s\" from %s:%d\n*/\n#define %s \\\n",
-			x->name, fname, lineno, &temp[0]);
+		james_expand(&line, &len, NULL, NULL);
+		fprintf(j, "\n/**\ninvocation of alias_plus \"%s\" from %s:%d\n*/\n#define %.*s \\\n",
+			x->name, fname, lineno, len, line);
 		if (isdebug) {
 			fflush(j);
 		}
@@ -1402,15 +2003,10 @@ void ap_inv_render(struct ap_invocation* z, FILE* j) {
 		{
 			struct alias_plus_macroline* ml = x->macro_lines;
 			while (ml != NULL) {
-				if (strlen(ml->line) > sizeof temp) {
-					fprintf(j, "/*error %s is too long (max chars %d)*/\n", ml->line, sizeof temp);
-					printf("/*error %s is too long (max chars %d)*/\n", ml->line, sizeof temp);
-					exit(__LINE__);
-					return;
-				}
-				memcpy(temp, ml->line, strlen(ml->line) + 1);
-				james_expand(temp, NULL, NULL);
-				fputs(temp, j);
+				line = ml->line;
+				len = (int)strlen(line);
+				james_expand(&line, &len, NULL, NULL);
+				fwrite(line, 1, len, j);
 				if (ml->next != NULL) {
 					fputs(" \\\n", j);
 				}
@@ -1428,14 +2024,21 @@ void ap_inv_render(struct ap_invocation* z, FILE* j) {
 		memcpy(g_je_filename, saved, sizeof g_je_filename);
 	}
 }
-void call_alias_plus(const char* linebuf, const char* fname, int lineno, FILE*j,int *opt_read_upto) {
+/**
+@param linebuf
+the line so far, a slice of the source rather than a string
+@param len
+how many characters it has
+*/
+static void call_alias_plus(const char* linebuf, int len, const char* fname, int lineno, FILE*j,int *opt_read_upto) {
 	struct alias_plus* x = g_tiap_ap;
+	const char* const end = linebuf + len;
 	const char* v = linebuf;
 	const char* ve = NULL;
 	char** varsubs = malloc(sizeof(char*)*x->numPositionals);
 	int i;
 	int num_varsubs;
-	while (*v != '\0' && *v != '(') {
+	while (v < end && *v != '\0' && *v != '(') {
 		++v;
 	}
 	++v;
@@ -1446,17 +2049,17 @@ void call_alias_plus(const char* linebuf, const char* fname, int lineno, FILE*j,
 	}
 
 	i = 0;
-	while (*v != '\0' && i < x->numPositionals) {
-		while (*v != '\0' && isspace(*v)) {
+	while (v < end && *v != '\0' && i < x->numPositionals) {
+		while (v < end && *v != '\0' && isspace(*v)) {
 			++v;
 		}
 		ve = v;
-		while (*ve != '\0' && *ve != ',' 
+		while (ve < end && *ve != '\0' && *ve != ',' 
 			&& !isspace(*ve) && *ve != ')') {
 			if (*ve == '"') {
 				char preve = *ve;
 				++ve;
-				while (*ve != '"' || preve == '\\') {
+				while (ve < end && (*ve != '"' || preve == '\\')) {
 					preve = *ve;
 					++ve;
 				}
@@ -1495,7 +2098,7 @@ void call_alias_plus(const char* linebuf, const char* fname, int lineno, FILE*j,
 			*opt_read_upto = ve - linebuf;
 		}
 		else {
-			*opt_read_upto = strlen(linebuf);
+			*opt_read_upto = len;
 		}
 	}
 	/*--free ram--*/
@@ -1507,43 +2110,587 @@ void call_alias_plus(const char* linebuf, const char* fname, int lineno, FILE*j,
 	free(varsubs);
 }
 
+/*--what one source file contributes, as recorded by parse_src()
+without touching anything in ram, so that a source file can be
+parsed on any thread and applied to the ram later on in the
+same order as the source files were given--*/
+/*--a 64 bit hash kept as two 32 bit halves, as ANSI C89 has no
+integer type that is sure to hold 64 bits, only unsigned long being
+sure to hold 32, see fnv1a()--*/
+struct hash64 {
+	unsigned long hi;
+	unsigned long lo;
+};
+/*--how a struct hash64 is written to and read from text files, as
+16 hex digits--*/
+#define HASH64_FMT "%08lx%08lx"
+#define HASH64_SCAN "%8lx%8lx"
+struct contrib_rec {
+	/*--'L' is a line of a james command, 'E' is the end of a
+	james command, 'C' is a line that might call an alias_plus,
+	'T' is a james block with no command, echoed into james.h as
+	it is, 'X' is the error that parsing stopped at--*/
+	char kind;
+	int hash;
+	/*--the line the james command started on for 'L', or the
+	line itself for 'C'--*/
+	int lineno;
+	/*--for 'C', from where in the line it had been tested--*/
+	int test_from;
+	char* text;
+	struct contrib_rec* next;
+};
+/*--what stat() says about a source file, for telling whether it
+changed since, -1 where it is not known--*/
+struct src_stamp {
+	long size;
+	long mtime;
+	long mtime_ns;
+	long ctime;
+	long ctime_ns;
+	long ino;
+};
+struct contrib {
+	char fname[sizeof g_je_filename];
+	/*--what parse_src() returned for it--*/
+	int ret;
+	int cant_open;
+	/*--fingerprint of the source file, only when --cache--*/
+	struct src_stamp stamp;
+	struct hash64 hash;
+	/*--whether contrib_apply() did anything to the ram with it, an
+	'L' or a 'C' that called an alias_plus, see -MD--*/
+	int contributed;
+	struct contrib_rec* head;
+	struct contrib_rec* tail;
+};
+static void contrib_init(struct contrib* c, const char* fname) {
+	memcpy(c->fname, fname, strlen(fname) + 1);
+	c->ret = 0;
+	c->cant_open = 0;
+	memset(&c->stamp, -1, sizeof c->stamp);
+	c->hash.hi = 0;
+	c->hash.lo = 0;
+	c->contributed = 0;
+	c->head = NULL;
+	c->tail = NULL;
+}
 /**
-@param j_opt
-optional parameter to the james.h file handle (append mode)
-@param s
-required parameter to the source code file handle (read mode)
-@param src_c_opt
-optional parameter to allow source overrides
-@return
-0 on okay, otherwise the line number of where the error was tested
+@param text
+copied, need not be null terminated when opt_textlen is given
+@param opt_textlen
+how many characters text has, -1 for all of it
+*/
+static void contrib_add(struct contrib* c, char kind, int hash, int lineno,
+	int test_from, const char* text, int opt_textlen) {
+	struct contrib_rec* r = malloc(sizeof(struct contrib_rec));
+	fail2malloc(r, __LINE__);
+	r->kind = kind;
+	r->hash = hash;
+	r->lineno = lineno;
+	r->test_from = test_from;
+	r->text = NULL;
+	r->next = NULL;
+	if (text != NULL) {
+		if (opt_textlen < 0) {
+			opt_textlen = (int)strlen(text);
+		}
+		r->text = malloc(opt_textlen + 1);
+		fail2malloc(r->text, __LINE__);
+		memcpy(r->text, text, opt_textlen);
+		r->text[opt_textlen] = '\0';
+	}
+	if (c->tail == NULL) {
+		c->head = r;
+	}
+	else {
+		c->tail->next = r;
+	}
+	c->tail = r;
+}
+#ifndef JAMES_NO_MAIN
+/*--with --optimistic what was recorded may be applied more than
+once, so it is kept rather than freed once applied--*/
+static int g_keep_contribs = 0;
+static void contrib_copy(struct contrib* dst, const struct contrib* src) {
+	struct contrib_rec* r;
+	for (r = src->head; r != NULL; r = r->next) {
+		contrib_add(dst, r->kind, r->hash, r->lineno, r->test_from, r->text, -1);
+	}
+}
+#endif
+/**
+Says the error that parse_src() stopped at when recording, which
+is only done once it is applied so that it comes out in order and
+not from whichever thread parsed it.
+@param j
+the james.h file handle (append mode), can be NULL
 */
-int parse_src(FILE* j_opt, FILE* s, const char * const src_c_opt);
+static void contrib_put_errors(const struct contrib* c, FILE* j) {
+	struct contrib_rec* r;
+	for (r = c->head; r != NULL; r = r->next) {
+		if (r->kind == 'X') {
+			printf("%s\n", r->text);
+			if (j != NULL) {
+				fprintf(j, "\n/*%s*/\n", r->text);
+			}
+		}
+	}
+}
+static void contrib_free(struct contrib* c) {
+	struct contrib_rec* r = c->head;
+	while (r != NULL) {
+		struct contrib_rec* next = r->next;
+		if (r->text != NULL) {
+			free(r->text);
+		}
+		free(r);
+		r = next;
+	}
+	c->head = NULL;
+	c->tail = NULL;
+}
 
-int parse_src(FILE* j, FILE* s, const char * const src_c) {
-	int line;
-	char c;
-	char c_m1;
-	char c_m2;
-	char c_m3;
-	char linebuf[LINEBUF_LEN];
-	int line_whitespace_only_sofar;
-	int line_ispreproc;
-	int line_jamescmdhash;
-	int line_havejamescmd;
-	int line_maybe_james;
-	int line_maybe_blockcomment;
-	int line_maybe_linecomment;
-	int line_is_linecomment;
-	int line_is_blockcomment;
-	int line_is_james;
-	int line_backslash_might_be_last;
-	int line_in_string;
-	int james_linebuf_w;
-	int line_james_written_overrides_yet;
-	int line_callaliasplus_readupto;
+/*--the characters that parse_buf() has to look at one by one, all
+the others only being copied into the line while the lexer is in a
+state that they cannot change, see lex_build() and scan_stop(). Compares 16 or 32 at once with SSE2
+or AVX2 (-mavx2), build with -DJAMES_NO_SIMD for plain C--*/
+#if !defined(JAMES_NO_SIMD) && defined(__AVX2__)
+#define JAMES_AVX2
+#include <immintrin.h>
+#elif !defined(JAMES_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JAMES_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(JAMES_AVX2) || defined(JAMES_SSE2))
+#include <intrin.h>
+/**
+@return the index of the lowest bit set in m, which must not be 0
+*/
+static int scan_first_bit(unsigned int m) {
+	unsigned long i;
+	_BitScanForward(&i, m);
+	return (int)i;
+}
+#elif defined(JAMES_AVX2) || defined(JAMES_SSE2)
+#define scan_first_bit(m) __builtin_ctz(m)
+#endif
+/**
+@return 1 if parse_buf() has to look at c by itself
+*/
+static int scan_is_stop(char c) {
+	switch (c) {
+	case '\n': case '\r': case '/': case '#':
+	case '\\': case '(': case ')':
+		return 1;
+	}
+	return 0;
+}
+/**
+Finds the next character that scan_is_stop().
+@return
+where it is, or end if there is none
+*/
+static const char* scan_stop(const char* p, const char* end) {
+#if defined(JAMES_AVX2)
+	const __m256i nl = _mm256_set1_epi8('\n');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i slash = _mm256_set1_epi8('/');
+	const __m256i hash = _mm256_set1_epi8('#');
+	const __m256i bslash = _mm256_set1_epi8('\\');
+	const __m256i open = _mm256_set1_epi8('(');
+	const __m256i close = _mm256_set1_epi8(')');
+	while (end - p >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+					_mm256_cmpeq_epi8(v, cr)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, slash),
+					_mm256_cmpeq_epi8(v, hash))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, bslash),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, open),
+					_mm256_cmpeq_epi8(v, close))));
+		unsigned int bits = (unsigned int)_mm256_movemask_epi8(m);
+		if (bits != 0) {
+			return p + scan_first_bit(bits);
+		}
+		p += 32;
+	}
+#elif defined(JAMES_SSE2)
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i hash = _mm_set1_epi8('#');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i open = _mm_set1_epi8('(');
+	const __m128i close = _mm_set1_epi8(')');
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)),
+				_mm_or_si128(_mm_cmpeq_epi8(v, slash),
+					_mm_cmpeq_epi8(v, hash))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, bslash),
+				_mm_or_si128(_mm_cmpeq_epi8(v, open),
+					_mm_cmpeq_epi8(v, close))));
+		unsigned int bits = (unsigned int)_mm_movemask_epi8(m);
+		if (bits != 0) {
+			return p + scan_first_bit(bits);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && !scan_is_stop(*p)) {
+		++p;
+	}
+	return p;
+}
+
+/*--parse_buf() knows where it is in a line from one number, the
+state of a lexer, rather than from a flag for each thing and the
+last few characters. Each character is looked up in g_lex_next
+for the state after it and what is to be done about it, with no
+tests of its own. lex_spec() is what the states mean and what the
+characters do to them, lex_build() makes g_lex_next from it by
+trying each kind of character on each state that can be reached.
+Where a comment or a string starts or ends changes nothing that
+james does, so they are not states; to make them matter, say so
+in lex_spec(), for instance with char literals and raw strings as
+states of their own, and the table grows but parse_buf() is no
+slower for it--*/
+struct lex_flags {
+	/*--nothing but white space on the line so far--*/
+	int ws;
+	/*--the line started with a slash (1), and a star after it (2)--*/
+	int maybe;
+	/*--a preprocessor line, "#" first on it or a line before
+	it ending with a backslash--*/
+	int pp;
+	/*--a backslash, with maybe white space after it, is last--*/
+	int bs;
+	/*--what the last character was, LP_*--*/
+	int prev;
+	/*--1 in a james block, 5 to 2 after "#J" to "#JAME" on a
+	preprocessor line, which is 1 once the "S" comes--*/
+	int james;
+};
+#define LP_OTHER 0
+#define LP_CR 1
+#define LP_LF 2
+#define LP_HASH 3
+#define LP_HASHSTAR 4
+/*--the kinds of characters, all others are LC_OTHER--*/
+#define LC_OTHER 0
+#define LC_SPACE 1
+#define LC_LF 2
+#define LC_CR 3
+#define LC_SLASH 4
+#define LC_STAR 5
+#define LC_HASH 6
+#define LC_BSLASH 7
+#define LC_J 8
+#define LC_A 9
+#define LC_M 10
+#define LC_E 11
+#define LC_S 12
+#define LC_CLASSES 13
+/*--what is to be done, in g_lex_next above the next state--*/
+#define LA_NEWLINE 0x1000
+#define LA_JAMES_OPEN 0x2000
+#define LA_JAMES_END 0x4000
+#define LX_STATE_MASK 0x03ff
+/*--more than enough for every lex_flags there can be--*/
+#define LX_MAX 1024
+/*--what parse_buf() can skip in a state without looking--*/
+#define LX_SKIP_NONE 0
+#define LX_SKIP_BLANKS 1
+#define LX_SKIP_PLAIN 2
+/**
+What one character does to the lexer, the way parse_buf() always
+did it, in this order.
+@param f
+the state before it, changed to the state after it
+@param k
+what kind of character it is, LC_*
+@return
+the LA_* to do about it
+*/
+static int lex_spec(struct lex_flags* f, int k) {
+	int act = 0;
+	/*--a "\n" right after a "\r" is no new line of its own--*/
+	if (k == LC_CR || (k == LC_LF && f->prev != LP_CR)) {
+		f->ws = 1;
+		f->maybe = 0;
+		/*--a backslash at the end goes on to the next line--*/
+		if (!f->bs) {
+			f->pp = 0;
+		}
+		f->bs = 0;
+		f->prev = k == LC_CR ? LP_CR : LP_LF;
+		return LA_NEWLINE;
+	}
+	if (f->james && k == LC_SLASH && f->prev == LP_HASHSTAR) {
+		f->james = 0;
+		act |= LA_JAMES_END;
+	}
+	if (k == LC_BSLASH) {
+		f->bs = 1;
+	}
+	else if (k != LC_SPACE && k != LC_LF) {
+		f->bs = 0;
+	}
+	/*--slash, star and "#" first on the line start a james block--*/
+	if (f->maybe == 1) {
+		f->maybe = k == LC_STAR ? 2 : 0;
+	}
+	else if (f->maybe == 2) {
+		if (k == LC_HASH) {
+			f->james = 1;
+			act |= LA_JAMES_OPEN;
+		}
+		else {
+			f->james = 0;
+		}
+		f->maybe = 0;
+	}
+	if (k == LC_SLASH && f->ws) {
+		f->maybe = 1;
+		f->pp = 0;
+	}
+	else if (k == LC_HASH && f->ws) {
+		f->pp = 1;
+	}
+	/*--so does "#JAMES" on a preprocessor line--*/
+	if (k == LC_J && f->prev == LP_HASH && f->pp && f->james == 0) {
+		f->james = 5;
+	}
+	else if (k == LC_A && f->prev == LP_OTHER && f->pp && f->james == 5) {
+		f->james = 4;
+	}
+	else if (k == LC_M && f->prev == LP_OTHER && f->pp && f->james == 4) {
+		f->james = 3;
+	}
+	else if (k == LC_E && f->prev == LP_OTHER && f->pp && f->james == 3) {
+		f->james = 2;
+	}
+	else if (k == LC_S && f->prev == LP_OTHER && f->pp && f->james == 2) {
+		f->james = 1;
+	}
+	else if (f->james != 1) {
+		f->james = 0;
+	}
+	if (k != LC_SPACE && k != LC_LF) {
+		f->ws = 0;
+	}
+	if (k == LC_HASH) {
+		f->prev = LP_HASH;
+	}
+	else if (k == LC_STAR && f->prev == LP_HASH) {
+		f->prev = LP_HASHSTAR;
+	}
+	else {
+		f->prev = LP_OTHER;
+	}
+	return act;
+}
+static int lex_pack(const struct lex_flags* f) {
+	return f->ws | f->maybe << 1 | f->pp << 3 | f->bs << 4
+		| f->prev << 5 | f->james << 8;
+}
+static void lex_unpack(struct lex_flags* f, int packed) {
+	f->ws = packed & 1;
+	f->maybe = packed >> 1 & 3;
+	f->pp = packed >> 3 & 1;
+	f->bs = packed >> 4 & 1;
+	f->prev = packed >> 5 & 7;
+	f->james = packed >> 8 & 7;
+}
+/*--the next state and LA_* for each state and LC_*, state 0 being
+the start of a file--*/
+static unsigned short g_lex_next[LX_MAX][LC_CLASSES];
+/*--the LC_* of each character--*/
+static unsigned char g_lex_class[256];
+/*--of each state, lex_flags::james and ::prev, and LX_SKIP_*--*/
+static unsigned char g_lex_james[LX_MAX];
+static unsigned char g_lex_prev[LX_MAX];
+static unsigned char g_lex_skip[LX_MAX];
+static int g_lex_states = 0;
+/**
+Makes g_lex_next and the rest from lex_spec(), once, before
+parse_buf() is first run, and before any threads are.
+*/
+static void lex_build(void) {
+	static int packed_of[LX_MAX];
+	static int state_of[1 << 11];
+	struct lex_flags f;
+	int n;
+	int i;
+	int k;
+	if (g_lex_states > 0) {
+		return;
+	}
+	for (i = 0; i < 256; ++i) {
+		g_lex_class[i] = LC_OTHER;
+		if (i < 128 && isspace(i)) {
+			g_lex_class[i] = LC_SPACE;
+		}
+	}
+	g_lex_class['\n'] = LC_LF;
+	g_lex_class['\r'] = LC_CR;
+	g_lex_class['/'] = LC_SLASH;
+	g_lex_class['*'] = LC_STAR;
+	g_lex_class['#'] = LC_HASH;
+	g_lex_class['\\'] = LC_BSLASH;
+	g_lex_class['J'] = LC_J;
+	g_lex_class['A'] = LC_A;
+	g_lex_class['M'] = LC_M;
+	g_lex_class['E'] = LC_E;
+	g_lex_class['S'] = LC_S;
+	for (i = 0; i < (int)(sizeof state_of / sizeof state_of[0]); ++i) {
+		state_of[i] = -1;
+	}
+	/*--a file starts like a line, after a character that is none
+	of the ones that matter--*/
+	memset(&f, 0, sizeof f);
+	f.ws = 1;
+	packed_of[0] = lex_pack(&f);
+	state_of[packed_of[0]] = 0;
+	/*--every state found is tried in turn, which finds more--*/
+	for (i = 0, n = 1; i < n; ++i) {
+		for (k = 0; k < LC_CLASSES; ++k) {
+			int act;
+			int to;
+			lex_unpack(&f, packed_of[i]);
+			act = lex_spec(&f, k);
+			to = lex_pack(&f);
+			if (state_of[to] < 0) {
+				if (n == LX_MAX) {
+					genericDie(__LINE__);
+				}
+				packed_of[n] = to;
+				state_of[to] = n;
+				++n;
+			}
+			g_lex_next[i][k] = (unsigned short)(state_of[to] | act);
+		}
+	}
+	for (i = 0; i < n; ++i) {
+		int plain = 1;
+		int blanks;
+		lex_unpack(&f, packed_of[i]);
+		g_lex_james[i] = (unsigned char)f.james;
+		g_lex_prev[i] = (unsigned char)f.prev;
+		for (k = 0; k < 256; ++k) {
+			if (!scan_is_stop((char)k)
+				&& g_lex_next[i][g_lex_class[k]] != i) {
+				plain = 0;
+			}
+		}
+		blanks = g_lex_next[i][LC_SPACE] == i;
+		/*--james blocks have more to do for each character--*/
+		g_lex_skip[i] = f.james ? LX_SKIP_NONE
+			: plain ? LX_SKIP_PLAIN
+			: blanks ? LX_SKIP_BLANKS
+			: LX_SKIP_NONE;
+	}
+	g_lex_states = n;
+}
+
+/**
+@param j_opt
+optional parameter to the james.h file handle (append mode)
+@param s
+required parameter to the source code file handle (read mode)
+@param src_c_opt
+optional parameter to allow source overrides
+@param rec_opt
+if not NULL then nothing is done to the ram, instead what the
+source file would have done is recorded here so that it can be
+done later with contrib_apply(), this is then safe to run on
+many threads at once
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int parse_src(FILE* j_opt, FILE* s, const char * const src_c_opt,
+	struct contrib* rec_opt);
+/**
+The same as parse_src() but for a source file that is already in
+ram, which is how every source file is parsed, walking it with a
+cursor rather than a call into the C library for each character.
+@param buf
+the content of the source file, need not be null terminated
+@param len
+how many bytes buf has
+*/
+static int parse_buf(FILE* j_opt, const char* buf, long len,
+	const char * const src_c_opt, struct contrib* rec_opt);
+
+static int parse_src(FILE* j, FILE* s, const char * const src_c,
+	struct contrib* rec) {
+	/*--read in big blocks and parsed in one go--*/
+	long cap = 65536;
+	long len = 0;
+	int ret;
+	char* buf = malloc(cap);
+	fail2malloc(buf, __LINE__);
+	while (1) {
+		size_t got = fread(buf + len, 1, cap - len, s);
+		len += (long)got;
+		if (got == 0) {
+			break;
+		}
+		if (len == cap) {
+			char* newbuf;
+			cap *= 2;
+			newbuf = realloc(buf, cap);
+			fail2malloc(newbuf, __LINE__);
+			buf = newbuf;
+		}
+	}
+	ret = parse_buf(j, buf, len, src_c, rec);
+	free(buf);
+	return ret;
+}
+
+static int parse_buf(FILE* j, const char* buf, long len, const char * const src_c,
+	struct contrib* rec) {
+	/*--where the next character is read from--*/
+	const char* cur = buf;
+	const char* const end = buf + len;
+	int line;
+	/*--line where the current james command started, kept here
+	rather than only in g_je_line so that recording does not
+	touch the globals--*/
+	int james_line;
+	/*--where in the line the alias_plus testing has been done
+	from, -1 if the last character was not tested--*/
+	int line_test_from;
+	char c;
+	/*--the state of the lexer, see lex_spec(), after the last
+	character and before it, and what it said about the last--*/
+	int st;
+	int was;
+	int e;
+	/*--the line so far is the slice of buf from here up to cur,
+	it is never copied, and how long it is once it ends--*/
+	const char* line_start;
+	int line_len;
+	int line_jamescmdhash;
+	int line_havejamescmd;
+	/*--lex_flags::james--*/
+	int line_is_james;
+	int line_james_written_overrides_yet;
+	int line_callaliasplus_readupto;
 	int line_needtostartjamesleadin_forecho;
 	char echobuf[100];
 	int echobuf_w;
+	/*--1 when the line so far was tested for an alias_plus call
+	after its last character, and was none, see scan_stop()--*/
+	int line_alias_quiet;
+	struct alias_match line_alias;
 
 	/*--duplicate in ap_inv_proc_alsos--*/
 	const int hash_ADDTOLIST = jchash("JAMES_ADD_TO_LIST");
@@ -1580,89 +2727,131 @@ command %d (value: %d)\n",
 	}
 
 	line = 1;
-	g_je_line = line;
-	c = fgetc(s);
-	c_m1 = '\0';
-	c_m2 = '\0';
-	c_m3 = '\0';
-	/*--all these need to be reset on each new line--*/
-	line_whitespace_only_sofar = 1;
-	line_ispreproc = 0;
+	james_line = line;
+	if (rec == NULL) {
+		g_je_line = james_line;
+	}
+	line_test_from = -1;
+	lex_build();
+	st = 0;
 	line_jamescmdhash = 0;
 	line_havejamescmd = 0;
-	line_maybe_james = 0;
-	line_maybe_blockcomment = 0;
-	line_maybe_linecomment = 0;
-	line_is_linecomment = 0;
-	line_is_blockcomment = 0;
 	line_is_james = 0;
-	line_backslash_might_be_last = 0;
-	line_in_string = 0;
-	james_linebuf_w = 0;
+	line_start = cur;
 	line_james_written_overrides_yet = 0;
 	line_callaliasplus_readupto = 0;
 	line_needtostartjamesleadin_forecho = 0;
-	while (!feof(s)) {
-		if (c == '\r' || c == '\n' && c_m1 != '\r') {
+	echobuf[0] = '\0';
+	echobuf_w = 0;
+	line_alias_quiet = 1;
+	alias_match_reset(&line_alias, 0);
+	while (cur < end) {
+		/*--runs of characters that cannot change the state of the
+		lexer are only stepped over, as long as no james
+		command is being read and the line was no alias_plus call
+		after its last character, which one without "(" or ")"
+		cannot change--*/
+		if (g_lex_skip[st] != LX_SKIP_NONE
+			&& !line_havejamescmd
+			&& (rec != NULL || line_alias_quiet)) {
+			const char* stop;
+			long n;
+			if (g_lex_skip[st] == LX_SKIP_BLANKS) {
+				stop = cur;
+				while (stop < end && (*stop == ' ' || *stop == '\t')) {
+					++stop;
+				}
+			}
+			else {
+				stop = scan_stop(cur, end);
+			}
+			n = (long)(stop - cur);
+			if (n > 0) {
+				if (rec != NULL && line_test_from < 0) {
+					line_test_from = (int)(cur - line_start);
+				}
+				cur = stop;
+				if (cur == end) {
+					break;
+				}
+			}
+		}
+		c = *cur;
+		++cur;
+		line_alias_quiet = 0;
+		was = st;
+		e = g_lex_next[st][g_lex_class[(unsigned char)c]];
+		st = e & LX_STATE_MASK;
+		/*--as it was before c--*/
+		line_is_james = g_lex_james[was];
+		if (e & LA_NEWLINE) {
+			line_len = slice_cut(line_start, (int)(cur - 1 - line_start));
 			if (line_is_james) {
-				/*--copy to james.h for memory--*/
-				if (j != NULL) {
-					fputc(c, j);
-					if (isdebug()) {
-						fflush(j);
+				/*--copy to james.h for memory, along with the rest
+				of the echo, otherwise each source file would add
+				its blank lines for every block it has--*/
+				if ((j != NULL || rec != NULL) && echobuf_w > 0) {
+					if (line_jamescmdhash == hash_ADDTOLIST
+						|| line_jamescmdhash == hash_ALIASPLUS
+						|| line_jamescmdhash == hash_INVOKEALIASPLUS
+						) {
+						/*--dont echo these please--*/
+					}
+					else if (echobuf_w < sizeof echobuf - 1) {
+						echobuf[echobuf_w++] = c;
+						echobuf[echobuf_w] = '\0';
 					}
 				}
 				line_james_written_overrides_yet = 0;
 			}
+			if (rec != NULL && line_test_from >= 0) {
+				int startlen;
+				if (alias_call_name(line_start, line_len, &startlen) != NULL) {
+					contrib_add(rec, 'C', 0, line, line_test_from,
+						line_start, line_len);
+				}
+			}
+			line_test_from = -1;
+			line_alias_quiet = 1;
+			alias_match_reset(&line_alias, 0);
 			line++;
 			//g_je_line = line;
 			/*--keep this in sync with above--*/
-			line_whitespace_only_sofar = 1;
 			if (!line_is_james) {
 				line_jamescmdhash = 0;
 			}
-			line_maybe_james = 0;
-			line_maybe_blockcomment = 0;
 			line_callaliasplus_readupto = 0;
-			line_maybe_linecomment = 0;
-			if (line_backslash_might_be_last) {
-				if (line_is_linecomment) {
-					line_is_linecomment = 1;
-				}
-				else if (line_ispreproc) {
-					line_ispreproc = 1;
-				}
-				else if (line_in_string) {
-					line_in_string = 1;
-				}
-			}
-			else {
-				line_is_linecomment = 0;
-				line_ispreproc = 0;
-				line_in_string = 0;
-			}
-			line_backslash_might_be_last = 0;
-			james_linebuf_w = 0;
-			/*
-			line_is_blockcomment = 0;
-			line_is_james=0;
-			*/
 			if (line_is_james && !line_havejamescmd) {
-				if (line > g_je_line+1) {
+				if (line > james_line+1) {
 					line_havejamescmd = 1;
 				}
 			}
+			else if (line_is_james && line_havejamescmd
+				&& rec != NULL
+				&& (line_jamescmdhash == hash_ADDTOLIST
+					|| line_jamescmdhash == hash_ALIASPLUS
+					|| line_jamescmdhash == hash_INVOKEALIASPLUS)) {
+				contrib_add(rec, 'L', line_jamescmdhash, james_line, 0,
+					line_start, line_len);
+			}
 			else if (line_is_james && line_havejamescmd) {
 
 				if (line_jamescmdhash == hash_ADDTOLIST) {
-					/*--we can make use of linebuf--*/
-					JAMES_ADD_TO_LIST(linebuf);
+					JAMES_ADD_TO_LIST(line_start, line_len);
 				}
 				else if (line_jamescmdhash == hash_ALIASPLUS) {
-					JAMES_ALIAS_PLUS(linebuf);
+					JAMES_ALIAS_PLUS(line_start, line_len);
 				}
 				else if (line_jamescmdhash == hash_INVOKEALIASPLUS) {
-					JAMES_INVOKE_ALIAS_PLUS(linebuf);
+					JAMES_INVOKE_ALIAS_PLUS(line_start, line_len);
+				}
+				else if (rec != NULL) {
+					/*--said by contrib_put_errors() once applied--*/
+					char msg[100];
+					sprintf(msg, "line %d: error, command that hashes\
+ to %d is not found (%ld)", line, line_jamescmdhash, (long)__LINE__);
+					contrib_add(rec, 'X', line_jamescmdhash, line, 0, msg, -1);
+					return __LINE__;
 				}
 				else {
 					printf("line %d: error, command that \
@@ -1677,25 +2866,15 @@ line,line_jamescmdhash,__LINE__);
 					return __LINE__;
 				}
 			}
+			line_start = cur;
 			/*--don't process the newline char anyfurther--*/
-
-			/*--loop continue must be copied down below as well--*/
-			c_m3 = c_m2;
-			c_m2 = c_m1;
-			c_m1 = c;
-			c = fgetc(s);
 			continue;
 		}
 
-
-		if (line_is_blockcomment) {
-			if (c == '/' && c_m1 == '*') {
-				line_is_blockcomment = 0;
-			}
-		}
 		if (line_is_james) {
-			/*--copy to james.h for memory--*/
-			if (j != NULL) {
+			/*--copy to james.h for memory, or only remember it, see
+			contrib_apply()--*/
+			if (j != NULL || rec != NULL) {
 				if (line_needtostartjamesleadin_forecho) {
 					line_needtostartjamesleadin_forecho = 0;
 					if (line_jamescmdhash == hash_ADDTOLIST
@@ -1721,10 +2900,10 @@ line,line_jamescmdhash,__LINE__);
 					}
 				}
 				if (c != '#'
-					&& !(c == '*' && c_m1=='#')
-					&& !(c == '/' && c_m1 == '*' && c_m2=='#')
+					&& !(c == '*' && g_lex_prev[was] == LP_HASH)
+					&& !(c == '/' && g_lex_prev[was] == LP_HASHSTAR)
 					&& !line_james_written_overrides_yet
-					&& line > (g_je_line+1)
+					&& line > (james_line+1)
 				) {
 					if (src_c != NULL) {
 						if (line_jamescmdhash == hash_ADDTOLIST
@@ -1734,7 +2913,7 @@ line,line_jamescmdhash,__LINE__);
 						}
 						else {
 							if (strlen(src_c) + 10 + echobuf_w < sizeof echobuf) {
-								sprintf(echobuf+echobuf_w, "@%s:%d$", src_c, g_je_line);
+								sprintf(echobuf+echobuf_w, "@%s:%d$", src_c, james_line);
 							}
 							//fprintf(j, "@%s:%d$", src_c, g_je_line);
 						}
@@ -1760,12 +2939,16 @@ line,line_jamescmdhash,__LINE__);
 					}*/
 				}
 			}
-			if (c == '/' && c_m1 == '*' && c_m2 == '#') {
-				line_is_james = 0;
+			if (e & LA_JAMES_END) {
 				/*--also duplicate these at the ap_inv_proc--*/
-				g_jatl_i = 0;
-				g_jap_i = 0;
-				g_jiap_i = 0;
+				if (rec != NULL) {
+					contrib_add(rec, 'E', 0, james_line, 0, NULL, -1);
+				}
+				else {
+					g_jatl_i = 0;
+					g_jap_i = 0;
+					g_jiap_i = 0;
+				}
 				line_havejamescmd = 0;
 				if (line_jamescmdhash == hash_ADDTOLIST
 					|| line_jamescmdhash == hash_ALIASPLUS
@@ -1773,8 +2956,11 @@ line,line_jamescmdhash,__LINE__);
 				{
 					/*--no echo for these please--*/
 				}
-				else {
-					if (strnlen(echobuf, sizeof echobuf_w + 1) > 0) {
+				else if (strnlen(echobuf, sizeof echobuf_w + 1) > 0) {
+					if (rec != NULL) {
+						contrib_add(rec, 'T', 0, james_line, 0, echobuf, -1);
+					}
+					else {
 						fputs(echobuf, j);
 					}
 				}
@@ -1785,125 +2971,32 @@ line,line_jamescmdhash,__LINE__);
 		}
 
 
-		if (c == '\\') {
-			line_backslash_might_be_last = 1;
-		}
-		else if (!isspace(c)) {
-			line_backslash_might_be_last = 0;
-		}
-
-		if (!line_is_linecomment
-			&& !line_is_blockcomment
-			&& !line_is_james
-			&& c == '"' && c_m1 != '\\') {
-			if (line_in_string) {
-				line_in_string = 0;
-			}
-			else {
-				line_in_string = 1;
-			}
-		}
-
-		/*--must come before initials--*/
-		if (line_maybe_linecomment) {
-			if (c == '/') {
-				line_is_linecomment = 1;
-				line_maybe_blockcomment = 0;
-				line_maybe_james = 0;
-			}
-			else {
-				line_maybe_linecomment = 0;
-			}
-		}
-
-		if (line_maybe_blockcomment == 1
-			|| line_maybe_james == 1) {
-			if (c == '*') {
-				line_maybe_james = 2;
-				line_maybe_blockcomment = 2;
+		if (e & LA_JAMES_OPEN) {
+			/*--only at the start of each block, so that
+			it can be used multiple times as the same
+			value--*/
+			james_line = line;
+			if (rec == NULL) {
+				g_je_line = james_line;
 			}
-			else {
-				line_maybe_james = 0;
-				line_maybe_blockcomment = 0;
-			}
-		}
-		else if (line_maybe_blockcomment == 2
-			|| line_maybe_james == 2) {
-			if (c == '#') {
-				line_maybe_james = 0;
-				line_is_james = 1;
-				line_maybe_blockcomment = 0;
-				/*--only at the start of each block, so that
-				it can be used multiple times as the same
-				value--*/
-				g_je_line = line;
-				if (j != NULL) {
-					/*--write to james.h for memory--*/
-					/*fputc('\n', j);
-					fputc('/', j);
-					fputc('*', j);
-					fputc('#', j);
-					if (isdebug()) {
-						fflush(j);
-					}*/
-					line_needtostartjamesleadin_forecho = 1;
-				}
-			}
-			else {
-				line_is_blockcomment = 1;
-				line_is_james = 0;
-				line_maybe_blockcomment = 0;
-				line_maybe_james = 0;
+			if (j != NULL || rec != NULL) {
+				/*--write to james.h for memory--*/
+				line_needtostartjamesleadin_forecho = 1;
 			}
 		}
-
-		/*--these are the initials--*/
-		if (c == '/' && line_whitespace_only_sofar) {
-			line_maybe_james = 1;
-line_maybe_blockcomment = 1;
-line_maybe_linecomment = 1;
-line_ispreproc = 0;
-		}
-		else if (c == '#' && line_whitespace_only_sofar) {
-		line_ispreproc = 1;
-		}
-
-
-
-		if (c == 'J' && c_m1 == '#'
-			&& line_ispreproc && line_is_james == 0) {
-			line_is_james = 5;
-		}
-		else if (c == 'A' && c_m1 == 'J'
-			&& line_ispreproc && line_is_james == 5) {
-			line_is_james = 4;
-		}
-		else if (c == 'M' && c_m1 == 'A'
-			&& line_ispreproc && line_is_james == 4) {
-			line_is_james = 3;
-		}
-		else if (c == 'E' && c_m1 == 'M'
-			&& line_ispreproc && line_is_james == 3) {
-			line_is_james = 2;
-		}
-		else if (c == 'S' && c_m1 == 'E'
-			&& line_ispreproc && line_is_james == 2) {
-			line_is_james = 1;
-		}
-		else if (line_is_james != 1) {
-			line_is_james = 0;
-		}
+		/*--as it is after c--*/
+		line_is_james = g_lex_james[st];
 
 
 
 		if (line_is_james && !line_havejamescmd &&
 			(c == '(' || c == '\r' || c == '\n')) {
-			if (line > g_je_line) {
+			if (line > james_line) {
 				line_havejamescmd = 1;
 			}
 		}
 		else if (line_is_james && !line_havejamescmd) {
-			if (line > g_je_line) {
+			if (line > james_line) {
 				line_jamescmdhash = jchashchar(line_jamescmdhash, c);
 			}
 		}
@@ -1917,6 +3010,14 @@ line_ispreproc = 0;
 			}
 			else if (line_jamescmdhash == hash_INVOKEALIASPLUS) {
 
+			}
+			else if (rec != NULL) {
+				/*--said by contrib_put_errors() once applied--*/
+				char msg[100];
+				sprintf(msg, "line %d: error, command that hashes\
+ to %d is not found (%ld)", line, line_jamescmdhash, (long)__LINE__);
+				contrib_add(rec, 'X', line_jamescmdhash, line, 0, msg, -1);
+				return __LINE__;
 			}
 			else {
 				printf("line %d: error, command that hashes\
@@ -1932,113 +3033,333 @@ line_ispreproc = 0;
 			}
 		}
 
-
-		if (!isspace(c)) {
-			line_whitespace_only_sofar = 0;
+		if (rec != NULL) {
+			/*--only remember from where, see contrib_apply()--*/
+			if (line_is_james) {
+				line_test_from = -1;
+			}
+			else if (line_test_from < 0) {
+				line_test_from = (int)(cur - 1 - line_start);
+			}
 		}
-
-		if (james_linebuf_w < sizeof(linebuf) - 1) {
-			linebuf[james_linebuf_w] = c;
-			linebuf[james_linebuf_w + 1] = '\0';
-			++james_linebuf_w;
+		else if (!line_is_james) {
+			g_tiap_ap = alias_match_feed(&line_alias, line_start,
+				(int)(cur - line_start));
+			if (g_tiap_ap == NULL) {
+				line_alias_quiet = 1;
+			}
+			else if (j != NULL) {
+				//alias_plus_render
+				call_alias_plus(line_start, (int)(cur - line_start), src_c,
+					line, j, &line_callaliasplus_readupto);
+				alias_match_reset(&line_alias, line_callaliasplus_readupto);
+			}
+		}
+	}
+	/*--the last line might not have had a newline--*/
+	if (rec != NULL && line_test_from >= 0) {
+		int startlen;
+		line_len = slice_cut(line_start, (int)(cur - line_start));
+		if (alias_call_name(line_start, line_len, &startlen) != NULL) {
+			contrib_add(rec, 'C', 0, line, line_test_from,
+				line_start, line_len);
 		}
+	}
 
-		if (!line_is_james
-			&& test_invocate_alias_plus(linebuf + line_callaliasplus_readupto)) {
+	return 0;
+}
 
-			if (j != NULL) {
+/**
+Does to the ram what parse_src() would have done to it for the
+source file that was recorded, in the same order.
+@param c
+what was recorded by parse_src()
+@param j
+the james.h file handle (append mode)
+*/
+static void contrib_apply(struct contrib* c, FILE* j) {
+	struct contrib_rec* r;
+	const int hash_ADDTOLIST = jchash("JAMES_ADD_TO_LIST");
+	const int hash_ALIASPLUS = jchash("JAMES_ALIAS_PLUS");
+	const int hash_INVOKEALIASPLUS = jchash("JAMES_INVOKE_ALIAS_PLUS");
 
-				//alias_plus_render
-				call_alias_plus(linebuf, src_c, line, j, &line_callaliasplus_readupto);
+	memcpy(g_je_filename, c->fname, strlen(c->fname) + 1);
+	g_jatl_i = 0;
+	g_jap_i = 0;
+	g_jiap_i = 0;
+	c->contributed = 0;
+	for (r = c->head; r != NULL; r = r->next) {
+		if (r->kind == 'L') {
+			const int len = (int)strlen(r->text);
+			c->contributed = 1;
+			g_je_line = r->lineno;
+			if (r->hash == hash_ADDTOLIST) {
+				JAMES_ADD_TO_LIST(r->text, len);
+			}
+			else if (r->hash == hash_ALIASPLUS) {
+				JAMES_ALIAS_PLUS(r->text, len);
+			}
+			else if (r->hash == hash_INVOKEALIASPLUS) {
+				JAMES_INVOKE_ALIAS_PLUS(r->text, len);
+			}
+		}
+		else if (r->kind == 'E') {
+			g_jatl_i = 0;
+			g_jap_i = 0;
+			g_jiap_i = 0;
+		}
+		else if (r->kind == 'T') {
+			if (j != NULL) {
+				fputs(r->text, j);
+			}
+		}
+		else if (r->kind == 'C') {
+			const int n = (int)strlen(r->text);
+			int startlen;
+			const char* start = alias_call_name(r->text, n, &startlen);
+			/*--while nothing is found the name tested stays the
+			same, so if it is no alias_plus nothing is found--*/
+			if (start != NULL && alias_plus_get(start, startlen) != NULL) {
+				int readupto = 0;
+				int w;
+				struct alias_match m;
+				alias_match_reset(&m, 0);
+				/*--test after each character like parse_src(), on
+				the line up to it--*/
+				for (w = r->test_from; w < n; ++w) {
+					g_tiap_ap = alias_match_feed(&m, r->text, w + 1);
+					if (g_tiap_ap != NULL) {
+						c->contributed = 1;
+						call_alias_plus(r->text, w + 1, c->fname, r->lineno, j, &readupto);
+						alias_match_reset(&m, readupto);
+					}
+				}
 			}
 		}
-
-		/*--loop continue must be copied up above as well--*/
-		c_m3 = c_m2;
-		c_m2 = c_m1;
-		c_m1 = c;
-		c = fgetc(s);
 	}
+	g_jatl_i = 0;
+	g_jap_i = 0;
+	g_jiap_i = 0;
+}
 
-	/*--now run all alsos from all alias_pluses from all alias_plus_invocations--*/
+/**
+Writes the #define of one list, with doxygen saying where its
+items came from.
+*/
+static void list_render(struct list* x, FILE* j) {
+	struct list_item* y;
+
+	/*--generate linked doxygen documentation--*/
+	fputs("/** The tool in james.c was used to create this list from\nthe source file(s) ", j);
 	{
-		struct ap_invocation* y = ap_inv_head;
+		int printed = 0;
+		y = x->head;
 		while (y != NULL) {
-			ap_inv_proc_alsos(y);
-			y = y->next;
-		}
-	}
-	
-
-	/*--after having read into ram all partially built
-	lists, write out into james.h--*/
-	if (j != NULL) {
-		fputs("\n/*--ram dump--*/\n\n", j);
-	}
-	if (j != NULL) {
-		/*--write lists--*/
-		struct list* x = first_list;
-		while (x != NULL) {
-			struct list_item* y;
-			fprintf(j, "\n/*#\nJAMES_ADD_TO_LIST\n%s\n", x->name);
-			y = x->head;
-			while (y != NULL) {
-				if (strnlen(y->fname, sizeof g_je_filename) > 0) {
-					fprintf(j, "@%s:%d$%s\n", y->fname, y->lineno, y->value);
+			if (y->fname != NULL && strlen(y->fname) > 0) {
+				/*--ensure it is unique / distinct list--*/
+				struct list_item* z = x->head;
+				int already = 0;
+				while (z != NULL && z != y) {
+					if (z->fname != NULL && strcmp(z->fname, y->fname) == 0) {
+						already = 1;
+						break;
+					}
+					z = z->next;
 				}
-				else {
-					fprintf(j, "%s\n", y->value);
+				if (!already) {
+					if (printed) {
+						fputs(", ", j);
+					}
+					printed = 1;
+					fputs(y->fname, j);
 				}
-				y = y->next;
 			}
-			fprintf(j, "#*/\n");
-
-			x = x->next_list;
+			y = y->next;
 		}
+	}
+	fputs("*/\n", j);
 
-		x = first_list;
-		while (x != NULL) {
-			struct list_item* y;
-
-			/*--generate linked doxygen documentation--*/
-			fputs("/** The tool in james.c was used to create this list from\nthe source file(s) ", j);
-			{
-				int printed = 0;
-				y = x->head;
-				while (y != NULL) {
-					if (y->fname != NULL && strlen(y->fname) > 0) {
-						/*--ensure it is unique / distinct list--*/
-						struct list_item* z = x->head;
-						int already = 0;
-						while (z != NULL && z != y) {
-							if (z->fname != NULL && strcmp(z->fname, y->fname) == 0) {
-								already = 1;
-								break;
-							}
-							z = z->next;
-						}
-						if (!already) {
-							if (printed) {
-								fputs(", ", j);
-							}
-							printed = 1;
-							fputs(y->fname, j);
-						}
-					}
-					y = y->next;
-				}
-			}
-			fputs("*/\n", j);
+	fprintf(j, "#define %s \\\n", x->name);
+	y = x->head;
+	while (y != NULL) {
+		fprintf(j, "%s%s\n",
+			y->value,
+			y->next != NULL ? ",\\" : "");
+		y = y->next;
+	}
+	fprintf(j, "\n");
+}
+/*--with --shard-dir each list, and each alias plus with all its
+invocations, goes into a header of its own in that folder (next
+to james.h) which james.h includes, so a source file including
+only the one it needs is only rebuilt when that one changes--*/
+#ifdef _POSIX_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+#ifdef _MSC_VER
+#include <direct.h>
+#endif
+static const char* g_shard_dir = NULL;
+static char g_shard_base[4096];
+/*--added to the name of each file while it is being written,
+unique to the process with --optimistic, as then they are
+written without holding the lock--*/
+static char g_tmp_ext[32] = ".tmp";
+/*--room for the path of james.h or of a shard with g_tmp_ext on
+the end, the same everywhere so that the name a temp file was made
+with is the name it is closed, moved and removed with--*/
+#define TMP_PATH_LEN (4096 + 256 + sizeof g_tmp_ext)
+/*--with --optimistic the shards are only moved into place once
+james.h is, see shards_pending_finish()--*/
+static int g_defer_shards = 0;
+static char** g_shards_pending = NULL;
+static int g_num_shards_pending = 0;
+static int g_shards_pending_alloced = 0;
+static int commit_james_h(FILE* j, const char* james_h);
+static int close_james_h(FILE* j, const char* james_h);
+static int move_james_h(const char* james_h);
+/**
+Works out the folder the shards of james_h go in, and makes it.
+*/
+static void shard_set_base(const char* james_h) {
+	const char* sep = strrchr(james_h, '/');
+	const char* sep2 = strrchr(james_h, '\\');
+	int dirlen;
+	if (g_shard_dir == NULL) {
+		return;
+	}
+	if (sep2 > sep) {
+		sep = sep2;
+	}
+	dirlen = (sep != NULL) ? (int)(sep - james_h) + 1 : 0;
+	snprintf(g_shard_base, sizeof g_shard_base, "%.*s%s", dirlen, james_h, g_shard_dir);
+#ifdef _POSIX_SOURCE
+	mkdir(g_shard_base, 0777);
+#elif defined(_MSC_VER)
+	_mkdir(g_shard_base);
+#endif
+}
+/**
+Starts the shard header called name, in "name.h.tmp" or so.
+@return
+the file handle for writing the rest, or NULL if it could not be
+written
+*/
+static FILE* shard_create(const char* name) {
+	char tmp[TMP_PATH_LEN];
+	FILE* sh;
+	snprintf(tmp, sizeof tmp, "%s/%s.h%s", g_shard_base, name, g_tmp_ext);
+	sh = fopen(tmp, "w");
+	if (sh == NULL) {
+		printf("error cannot open '%s' for writing\n", tmp);
+		return NULL;
+	}
+	fprintf(sh, "/**@file %s.h\n@brief externally generated header from \"james\" program,\nsee james.h\n*/\n#ifndef james_%s_h\n#define james_%s_h\n\n",
+		name, name, name);
+	return sh;
+}
+/**
+Finishes the shard header called name, and moves it into place if
+it changed, see commit_james_h().
+*/
+static void shard_commit(FILE* sh, const char* name) {
+	char path[4096 + 256];
+	snprintf(path, sizeof path, "%s/%s.h", g_shard_base, name);
+	fprintf(sh, "\n#endif /*james_%s_h*/\n", name);
+	if (!g_defer_shards) {
+		commit_james_h(sh, path);
+		return;
+	}
+	if (close_james_h(sh, path) != 0) {
+		return;
+	}
+	if (g_num_shards_pending == g_shards_pending_alloced) {
+		char** newpending;
+		g_shards_pending_alloced += 64;
+		newpending = realloc(g_shards_pending, sizeof(char*) * g_shards_pending_alloced);
+		fail2malloc(newpending, __LINE__);
+		g_shards_pending = newpending;
+	}
+	g_shards_pending[g_num_shards_pending] = malloc(strlen(path) + 1);
+	fail2malloc(g_shards_pending[g_num_shards_pending], __LINE__);
+	memcpy(g_shards_pending[g_num_shards_pending], path, strlen(path) + 1);
+	++g_num_shards_pending;
+}
+#ifndef JAMES_NO_MAIN
+/**
+Moves the shards written by shard_commit() into place, or throws
+them away if james.h was not.
+*/
+static void shards_pending_finish(int keep) {
+	int i;
+	for (i = 0; i < g_num_shards_pending; ++i) {
+		if (keep) {
+			move_james_h(g_shards_pending[i]);
+		}
+		else {
+			char tmp[TMP_PATH_LEN];
+			snprintf(tmp, sizeof tmp, "%s%s", g_shards_pending[i], g_tmp_ext);
+			remove(tmp);
+		}
+		free(g_shards_pending[i]);
+	}
+	g_num_shards_pending = 0;
+}
+#endif
+/**
+Runs the alsos of every alias_plus invocation and then writes
+everything that is held in ram out to the james.h file, this
+is done once after all of the source files have been parsed.
+@param j
+the james.h file handle (append mode), if NULL then only the
+alsos are run
+*/
+static void finish_james_h(FILE* j) {
+	struct ap_invocation* z;
 
-			fprintf(j, "#define %s \\\n", x->name);
+	/*--now run all alsos from all alias_pluses from all alias_plus_invocations--*/
+	ap_inv_proc_alsos_after(NULL);
+
+	/*--after having read into ram all partially built
+	lists, write out into james.h--*/
+	if (j != NULL) {
+		fputs("\n/*--ram dump--*/\n\n", j);
+	}
+	if (j != NULL) {
+		/*--write lists--*/
+		struct list* x = first_list;
+		while (x != NULL) {
+			struct list_item* y;
+			fprintf(j, "\n/*#\nJAMES_ADD_TO_LIST\n%s\n", x->name);
 			y = x->head;
 			while (y != NULL) {
-				fprintf(j, "%s%s\n",
-					y->value,
-					y->next != NULL ? ",\\" : "");
+				if (strnlen(y->fname, sizeof g_je_filename) > 0) {
+					fprintf(j, "@%s:%d$%s\n", y->fname, y->lineno, y->value);
+				}
+				else {
+					fprintf(j, "%s\n", y->value);
+				}
 				y = y->next;
 			}
-			fprintf(j, "\n");
+			fprintf(j, "#*/\n");
+
+			x = x->next_list;
+		}
+
+		x = first_list;
+		while (x != NULL) {
+			if (g_shard_dir != NULL) {
+				FILE* sh = shard_create(x->name);
+				if (sh != NULL) {
+					list_render(x, sh);
+					shard_commit(sh, x->name);
+				}
+				fprintf(j, "#include \"%s/%s.h\"\n", g_shard_dir, x->name);
+			}
+			else {
+				list_render(x, j);
+			}
 			x = x->next_list;
 		}
 	}
@@ -2104,10 +3425,40 @@ line_ispreproc = 0;
 	}
 
 	/*--render all alias_plus_invocations--*/
-	struct ap_invocation* z = ap_inv_head;
-	while (z != NULL) {
-		ap_inv_render(z, j);
-		z = z->next;
+	if (g_shard_dir != NULL && j != NULL) {
+		struct alias_plus* x;
+		for (x = alias_plus_head; x != NULL; x = x->next) {
+			FILE* sh = NULL;
+			for (z = ap_inv_head; z != NULL; z = z->next) {
+				if (strcmp(z->name, x->name) != 0) {
+					continue;
+				}
+				if (sh == NULL) {
+					sh = shard_create(x->name);
+					if (sh == NULL) {
+						break;
+					}
+					fprintf(j, "#include \"%s/%s.h\"\n", g_shard_dir, x->name);
+				}
+				ap_inv_render(z, sh);
+			}
+			if (sh != NULL) {
+				shard_commit(sh, x->name);
+			}
+		}
+		/*--the ones with no alias plus, for the error--*/
+		for (z = ap_inv_head; z != NULL; z = z->next) {
+			if (alias_plus_get(z->name, -1) == NULL) {
+				ap_inv_render(z, j);
+			}
+		}
+	}
+	else {
+		z = ap_inv_head;
+		while (z != NULL) {
+			ap_inv_render(z, j);
+			z = z->next;
+		}
 	}
 	
 
@@ -2116,12 +3467,10 @@ line_ispreproc = 0;
 	if (j != NULL) {
 		fwrite(headerfile_footer, 1, strlen(headerfile_footer), j);
 	}
-
-	return 0;
 }
 
 
-int old_parse(int doit, FILE* j) {
+static int old_parse(int doit, FILE* j) {
 	char linebuf[250];
 	int nextline_start_a_list = 0;
 	int nextline_in_list = 0;
@@ -2202,7 +3551,7 @@ much to list name %s\n", linebuf);
 						++start;
 					}
 
-					add_list_item(listname, start,NULL,NULL);
+					add_list_item(listname, start, -1, NULL, NULL);
 
 				}
 			}
@@ -2258,7 +3607,7 @@ much to list name %s\n", linebuf);
 
 #include <time.h>
 #define TIMBUFSZ 120
-void gtimbuf(char* timbuf) {
+static void gtimbuf(char* timbuf) {
 	time_t t;
 	struct tm tm;
 	struct tm *tmp;
@@ -2267,137 +3616,4934 @@ void gtimbuf(char* timbuf) {
 	memcpy(&tm, tmp, sizeof tm);
 	strftime(timbuf, TIMBUFSZ, "%I:%M:%S %p %a %b %d %Y", &tm);
 }
-int main(int argc, char** argv){
-	FILE *j;
-	FILE *s;
-	//int line;
-	//char c;
-	//char c_m1;
-	//char c_m2;
-	//char c_m3;
-	const char * james_h;
-	const char* src_c;
-	//char linebuf[250];
-	//int line_whitespace_only_sofar;
-	//int line_ispreproc;
-	//int line_isjames;
-	//int line_jamescmdhash;
-	//int line_havejamescmd;
-	//int line_maybe_james;
-	//int line_maybe_blockcomment;
-	//int line_maybe_linecomment;
-	//int line_is_linecomment;
-	//int line_is_blockcomment;
-	//int line_is_james;
-	//int line_backslash_might_be_last;
-	//int line_in_string;
-	//int james_linebuf_w;
-	char src_c_filename[100];
-	
-	const int hash_ADDTOLIST = jchash("JAMES_ADD_TO_LIST");
-	
-	if(argc != 3) {
-		if (isdebug()) {
-			james_h = "C:\\dev\\fsrc\\ginclude\\james.h";
-			//remove(james_h);
-			src_c = "C:\\dev\\fsrc\\lib\\everynms.h";
+/**
+Gets the file name part of the path, without any of the folders,
+which is what @ expands to.
+@param out
+must be at least as big as g_je_filename
+@param src_c
+the path of the source file as given on the command line
+*/
+static void src_basename(char* out, const char* src_c) {
+	const char* base = src_c;
+	int z;
+	int n;
+	for (z = strlen(src_c); z >= 0; --z) {
+		if (src_c[z] == '/' || src_c[z] == '\\') {
+			base = &src_c[z + 1];
+			break;
 		}
-		else {
-			puts("usage: path\\to\\james.h source\\file.c");
-			return 1;
+	}
+	n = strlen(base);
+	/*--same length limit as always so that the fname of
+	things already in james.h still match when re-run--*/
+	if (n + 3 > sizeof g_je_filename) {
+		n = (sizeof g_je_filename) - 3;
+	}
+	memcpy(out, base, n);
+	out[n] = '\0';
+}
+
+#include <sys/types.h>
+#include <sys/stat.h>
+/*--14695981039346656037, where a 64 bit FNV-1a hash starts--*/
+static const struct hash64 s_fnv1a_init = { 0xCBF29CE4UL, 0x84222325UL };
+/**
+Goes on with a 64 bit FNV-1a hash, whose prime 1099511628211 is
+2^40 + 0x1B3, so each step is h * 0x1B3 + (h << 40) with the
+halves in 32 bits, the low half cut in two so that its carry into
+the high half does not overflow an unsigned long either.
+*/
+static struct hash64 fnv1a(struct hash64 h, const unsigned char* data, long n) {
+	long i;
+	for (i = 0; i < n; ++i) {
+		unsigned long pl;
+		unsigned long ph;
+		h.lo ^= data[i];
+		pl = (h.lo & 0xFFFFUL) * 0x1B3UL;
+		ph = ((h.lo >> 16) & 0xFFFFUL) * 0x1B3UL;
+		h.hi = (h.hi * 0x1B3UL + ((ph + (pl >> 16)) >> 16) + (h.lo << 8))
+			& 0xFFFFFFFFUL;
+		h.lo = (pl + (ph << 16)) & 0xFFFFFFFFUL;
+	}
+	return h;
+}
+static int hash64_same(struct hash64 a, struct hash64 b) {
+	return a.hi == b.hi && a.lo == b.lo;
+}
+/**
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int file_hash(const char* path, struct hash64* hash) {
+	unsigned char buf[65536];
+	size_t n;
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		return __LINE__;
+	}
+	*hash = s_fnv1a_init;
+	while ((n = fread(buf, 1, sizeof buf, f)) > 0) {
+		*hash = fnv1a(*hash, buf, (long)n);
+	}
+	fclose(f);
+	return 0;
+}
+
+/**
+Records what a source file already read into ram contributes.
+@param buf
+the content of the source file, need not be null terminated
+*/
+static void contrib_parse_buf(struct contrib* c, const char* buf, long len) {
+	c->ret = parse_buf(NULL, buf, len, c->fname, c);
+}
+
+/*--from here on down to the james.h.state snapshot, only for
+main()--*/
+#ifndef JAMES_NO_MAIN
+/*--the nanoseconds of the times from stat(), where it has them--*/
+#if defined(__APPLE__) && (!defined(_POSIX_C_SOURCE) || defined(_DARWIN_C_SOURCE))
+#define ST_MTIME_NS(st) ((long)(st).st_mtimespec.tv_nsec)
+#define ST_CTIME_NS(st) ((long)(st).st_ctimespec.tv_nsec)
+#elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L
+#define ST_MTIME_NS(st) ((long)(st).st_mtim.tv_nsec)
+#define ST_CTIME_NS(st) ((long)(st).st_ctim.tv_nsec)
+#else
+#define ST_MTIME_NS(st) 0L
+#define ST_CTIME_NS(st) 0L
+#endif
+static void src_stamp_get(struct src_stamp* s, const struct stat* st) {
+	s->size = (long)st->st_size;
+	s->mtime = (long)st->st_mtime;
+	s->mtime_ns = ST_MTIME_NS(*st);
+	s->ctime = (long)st->st_ctime;
+	s->ctime_ns = ST_CTIME_NS(*st);
+	s->ino = (long)st->st_ino;
+}
+static int src_stamp_same(const struct src_stamp* a, const struct src_stamp* b) {
+	return a->size == b->size && a->mtime == b->mtime
+		&& a->mtime_ns == b->mtime_ns && a->ctime == b->ctime
+		&& a->ctime_ns == b->ctime_ns && a->ino == b->ino;
+}
+/*--the --cache sidecar file remembers what each source file
+contributed last time, along with its stamp, see src_stamp, and
+a hash of its contents, so that source files that did not change
+do not need to be read or parsed again--*/
+struct cache_entry {
+	char* path;
+	struct contrib c;
+	/*--if it is part of the james.h the cache was saved with--*/
+	int live;
+	/*--which of g_srcs it is this time, or -1--*/
+	int src_i;
+	/*--in the order they were first seen--*/
+	struct cache_entry* next;
+	struct cache_entry* next_in_bucket;
+};
+#define CACHE_BUCKETS 1024
+static const char* g_cache_path = NULL;
+static const char* s_cache_magic = "/*--james cache 3--*/";
+/*--hash of the james.h that was made from nothing but the live
+cache entries, while james.h still has this hash the cache knows
+which source file contributed what to it--*/
+static int g_cache_have_h = 0;
+static struct hash64 g_cache_h;
+static struct cache_entry* g_cache_buckets[CACHE_BUCKETS];
+static struct cache_entry* g_cache_head = NULL;
+static struct cache_entry* g_cache_tail = NULL;
+/*--which --cache file was loaded, see cache_reload(), and when it
+was written, see cache_racy()--*/
+static long g_cache_loaded_ino = -1;
+static long g_cache_loaded_size = -1;
+static long g_cache_loaded_mtime = -1;
+static long g_cache_loaded_mtime_ns = -1;
+/**
+A source file changed in the same tick as the cache file was
+written may have changed again after it went in, with the same
+size and modified time, so its fingerprint proves nothing and
+it has to be hashed, see cache_lookup().
+@return
+1 if s was not modified before the --cache file was written
+*/
+static int cache_racy(const struct src_stamp* s) {
+	if (g_cache_loaded_mtime < 0) {
+		return 1;
+	}
+	return s->mtime > g_cache_loaded_mtime
+		|| (s->mtime == g_cache_loaded_mtime
+			&& s->mtime_ns >= g_cache_loaded_mtime_ns);
+}
+static struct cache_entry* cache_find(const char* path) {
+	struct hash64 h = fnv1a(s_fnv1a_init,
+		(const unsigned char*)path, (long)strlen(path));
+	struct cache_entry* e = g_cache_buckets[h.lo % CACHE_BUCKETS];
+	while (e != NULL) {
+		if (strcmp(e->path, path) == 0) {
+			return e;
 		}
+		e = e->next_in_bucket;
+	}
+	return NULL;
+}
+static struct cache_entry* cache_add(const char* path) {
+	struct hash64 h = fnv1a(s_fnv1a_init,
+		(const unsigned char*)path, (long)strlen(path));
+	struct cache_entry* e = malloc(sizeof(struct cache_entry));
+	char fname[sizeof g_je_filename];
+	fail2malloc(e, __LINE__);
+	e->path = malloc(strlen(path) + 1);
+	fail2malloc(e->path, __LINE__);
+	memcpy(e->path, path, strlen(path) + 1);
+	src_basename(fname, path);
+	contrib_init(&e->c, fname);
+	e->live = 0;
+	e->src_i = -1;
+	e->next = NULL;
+	e->next_in_bucket = g_cache_buckets[h.lo % CACHE_BUCKETS];
+	g_cache_buckets[h.lo % CACHE_BUCKETS] = e;
+	if (g_cache_tail == NULL) {
+		g_cache_head = e;
 	}
 	else {
-		james_h = argv[1];
-		src_c = argv[2];
+		g_cache_tail->next = e;
 	}
-	
-	
-	lock();
-	
-	j = fopen(james_h,"r");
-	if(j != NULL) {
-		int subret;
-		old_parse(0,j);
-		subret = parse_src(NULL, j, NULL);
-		fclose(j);
-		if (subret) {
-			unlock();
-			return subret;
+	g_cache_tail = e;
+	return e;
+}
+/**
+Fingerprints the source file and if the cache has the same
+fingerprint for it then copies what it contributed last time.
+Only reads the cache so it is run on any thread.
+@return
+1 if it came from the cache, 0 if it has to be parsed
+*/
+static int cache_lookup(struct contrib* c, const char* src_c) {
+	struct stat st;
+	struct cache_entry* e;
+	if (stat(src_c, &st) != 0) {
+		return 0;
+	}
+	src_stamp_get(&c->stamp, &st);
+	e = cache_find(src_c);
+	if (e != NULL && src_stamp_same(&e->c.stamp, &c->stamp)
+		&& !cache_racy(&e->c.stamp)) {
+		c->hash = e->c.hash;
+		contrib_copy(c, &e->c);
+		return 1;
+	}
+	/*--touched but maybe not changed--*/
+	if (file_hash(src_c, &c->hash) != 0) {
+		return 0;
+	}
+	if (e != NULL && e->c.stamp.size == c->stamp.size
+		&& hash64_same(e->c.hash, c->hash)) {
+		contrib_copy(c, &e->c);
+		return 1;
+	}
+	return 0;
+}
+/**
+Remembers what the source file contributed this time, taking
+the records from c.
+*/
+static void cache_store(const char* src_c, struct contrib* c) {
+	struct cache_entry* e = cache_find(src_c);
+	if (e == NULL) {
+		e = cache_add(src_c);
+	}
+	contrib_free(&e->c);
+	e->c.stamp = c->stamp;
+	e->c.hash = c->hash;
+	e->live = 1;
+	if (g_keep_contribs) {
+		contrib_copy(&e->c, c);
+		return;
+	}
+	e->c.head = c->head;
+	e->c.tail = c->tail;
+	c->head = NULL;
+	c->tail = NULL;
+}
+static void cache_clear_live(void) {
+	struct cache_entry* e;
+	for (e = g_cache_head; e != NULL; e = e->next) {
+		e->live = 0;
+	}
+}
+static void cache_put_text(FILE* f, const char* text) {
+	for (; *text != '\0'; ++text) {
+		if (*text == '\\') {
+			fputs("\\\\", f);
+		}
+		else if (*text == '\n') {
+			fputs("\\n", f);
+		}
+		else if (*text == '\r') {
+			fputs("\\r", f);
+		}
+		else {
+			fputc(*text, f);
 		}
 	}
-	remove(james_h);
-	j = fopen(james_h,"r");
-	
-	if (j == NULL) {
-		/*--first invocation, create and write header--*/
-		j = fopen(james_h, "w");
-		if (j == NULL) {
-			printf("error cannot open '%s' for writing\n",
-				james_h);
-			unlock();
-			return __LINE__;
+	fputc('\n', f);
+}
+static void cache_get_text(char* text) {
+	char* w = text;
+	for (; *text != '\0'; ++text) {
+		if (*text == '\\' && text[1] != '\0') {
+			++text;
+			if (*text == 'n') {
+				*w++ = '\n';
+			}
+			else if (*text == 'r') {
+				*w++ = '\r';
+			}
+			else {
+				*w++ = *text;
+			}
 		}
-		fwrite(header, 1, strlen(header), j);
-		{
-			char timbuf[TIMBUFSZ+1];
-			gtimbuf(&timbuf[0]);
-			fprintf(j, "\n/*\nGenerated on %s\n*/\n\n", timbuf);
+		else {
+			*w++ = *text;
 		}
-		fclose(j);
-	} else {
-		/*-already exists, append--*/
-		fclose(j);
 	}
-	j = fopen(james_h,"a");
-	if(j == NULL) {
-		printf("error cannot open '%s' for appending\n",
-			james_h);
-		unlock();
-		return __LINE__;
+	*w = '\0';
+}
+/**
+Writes one source file's fingerprint and what it contributed.
+*/
+static void cache_put_entry(FILE* f, const char* path, int live, const struct contrib* c) {
+	struct contrib_rec* r;
+	fprintf(f, "S %d %ld %ld %ld %ld %ld %ld " HASH64_FMT " %s\n", live,
+		c->stamp.size, c->stamp.mtime, c->stamp.mtime_ns, c->stamp.ctime,
+		c->stamp.ctime_ns, c->stamp.ino, c->hash.hi, c->hash.lo, path);
+	for (r = c->head; r != NULL; r = r->next) {
+		if (r->kind == 'L') {
+			fprintf(f, "L %d %d ", r->hash, r->lineno);
+			cache_put_text(f, r->text);
+		}
+		else if (r->kind == 'C') {
+			fprintf(f, "C %d %d ", r->lineno, r->test_from);
+			cache_put_text(f, r->text);
+		}
+		else if (r->kind == 'T') {
+			fprintf(f, "T %d 0 ", r->lineno);
+			cache_put_text(f, r->text);
+		}
+		else {
+			fprintf(f, "%c\n", r->kind);
+		}
 	}
-	s = fopen(src_c,"r");
-	if(s == NULL) {
-		printf("error cannot open '%s' for reading\n",
-			src_c);
-		unlock();
-		return __LINE__;
+	fputs(".\n", f);
+}
+/**
+Reads one line like fgets() does, however long it is.
+@param buf
+grown as needed and kept for the next line, free() it when done
+@param cap
+how big buf is, 0 with a NULL buf to start
+@return
+how many characters were read, including the newline if there
+was one, 0 at the end of the file
+*/
+static long get_whole_line(FILE* f, char** buf, long* cap) {
+	long n = 0;
+	for (;;) {
+		if (*cap - n < 2) {
+			long want = *cap > 0 ? *cap * 2 : 512;
+			char* grown = realloc(*buf, want);
+			fail2malloc(grown, __LINE__);
+			*buf = grown;
+			*cap = want;
+		}
+		if (fgets(*buf + n, (int)(*cap - n), f) == NULL) {
+			break;
+		}
+		n += (long)strlen(*buf + n);
+		if (n > 0 && (*buf)[n - 1] == '\n') {
+			break;
+		}
 	}
-
-	/*--real parse--*/
-	g_je_line = 0;
-	{
-		int z;
-		for (z = strlen(src_c); z >= 0; --z) {
-			if (src_c[z] == '/' || src_c[z] == '\\') {
-				int n = strlen(src_c) - z;
-				if (n + 2 > sizeof g_je_filename) {
-					n = (sizeof g_je_filename)-2;
-				}
-				memcpy(g_je_filename , &src_c[z+1], n-1);
-				g_je_filename[n] = '\0';
-				break;
-			}
+	(*buf)[n] = '\0';
+	return n;
+}
+/**
+Reads the fingerprint line that cache_put_entry() starts each
+source file with.
+@param pathat
+set to where in linebuf the path of the source file starts
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int cache_get_stamp(const char* linebuf, int* live, struct src_stamp* s,
+	struct hash64* hash, int* pathat) {
+	*pathat = 0;
+	if (sscanf(linebuf, "S %d %ld %ld %ld %ld %ld %ld " HASH64_SCAN " %n",
+			live, &s->size, &s->mtime, &s->mtime_ns, &s->ctime,
+			&s->ctime_ns, &s->ino, &hash->hi, &hash->lo, pathat) == 9
+		&& *pathat != 0) {
+		return 0;
+	}
+	return __LINE__;
+}
+/**
+Reads what one source file contributed from a line based text
+file written by cache_put_entry(), up to and including its "."
+line.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int cache_get_entry(FILE* f, struct contrib* c) {
+	/*--the lines of james commands have no limit on how long they
+	are, so neither do these--*/
+	char* linebuf = NULL;
+	long cap = 0;
+	long n;
+	int ret = __LINE__;
+	while ((n = get_whole_line(f, &linebuf, &cap)) > 0) {
+		char* text;
+		int a;
+		int b;
+		int textat = 0;
+		if (linebuf[n - 1] != '\n') {
+			break;
+		}
+		linebuf[n - 1] = '\0';
+		if (linebuf[0] == '.') {
+			ret = 0;
+			break;
+		}
+		if (linebuf[0] == 'E') {
+			contrib_add(c, 'E', 0, 0, 0, NULL, -1);
+			continue;
+		}
+		if ((linebuf[0] != 'L' && linebuf[0] != 'C' && linebuf[0] != 'T')
+			|| sscanf(linebuf + 1, "%d %d%n", &a, &b, &textat) != 2
+			|| linebuf[1 + textat] != ' ') {
+			ret = __LINE__;
+			break;
+		}
+		/*--the text starts after the one space after the second
+		number, its own leading spaces are kept--*/
+		text = linebuf + 1 + textat + 1;
+		cache_get_text(text);
+		if (linebuf[0] == 'L') {
+			contrib_add(c, 'L', a, b, 0, text, -1);
+		}
+		else if (linebuf[0] == 'T') {
+			contrib_add(c, 'T', 0, a, 0, text, -1);
+		}
+		else {
+			contrib_add(c, 'C', 0, a, b, text, -1);
 		}
-		memcpy(src_c_filename, g_je_filename, strlen(g_je_filename) + 1);
 	}
-
+	free(linebuf);
+	return ret;
+}
+/**
+Loads the --cache file, if it is missing or cannot be understood
+then there is nothing cached and everything gets parsed.
+*/
+static void cache_load(const char* path) {
+	char linebuf[8192];
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		return;
+	}
 	{
-		int second_subret;
-		second_subret = parse_src(j, s, src_c_filename);
-		if (second_subret != 0) {
-			fprintf(j,"\n/* (while processing file %s) */\n", src_c);
-			printf( "\n/* (while processing file %s) */\n", src_c);
-			unlock();
-			/*--don't want to return 0, so that build system knows problem--*/
-			return second_subret;
+		struct stat st;
+		if (stat(path, &st) == 0) {
+			g_cache_loaded_ino = (long)st.st_ino;
+			g_cache_loaded_size = (long)st.st_size;
+			g_cache_loaded_mtime = (long)st.st_mtime;
+			g_cache_loaded_mtime_ns = ST_MTIME_NS(st);
 		}
 	}
+	if (fgets(linebuf, sizeof linebuf, f) == NULL
+		|| strncmp(linebuf, s_cache_magic, strlen(s_cache_magic)) != 0
+		|| fgets(linebuf, sizeof linebuf, f) == NULL) {
+		fclose(f);
+		return;
+	}
+	g_cache_have_h = (sscanf(linebuf, "H " HASH64_SCAN,
+		&g_cache_h.hi, &g_cache_h.lo) == 2);
+	while (fgets(linebuf, sizeof linebuf, f) != NULL) {
+		int live;
+		struct src_stamp stamp;
+		struct hash64 hash;
+		int pathat;
+		struct cache_entry* e;
+		int n = strlen(linebuf);
+		if (n > 0 && linebuf[n - 1] == '\n') {
+			linebuf[n - 1] = '\0';
+		}
+		if (cache_get_stamp(linebuf, &live, &stamp, &hash, &pathat) != 0) {
+			g_cache_have_h = 0;
+			printf("warning ignoring the rest of '%s'\n", path);
+			break;
+		}
+		e = cache_find(linebuf + pathat);
+		if (e == NULL) {
+			e = cache_add(linebuf + pathat);
+		}
+		contrib_free(&e->c);
+		e->live = live;
+		e->c.stamp = stamp;
+		e->c.hash = hash;
+		if (cache_get_entry(f, &e->c) != 0) {
+			/*--better parsed again than half remembered--*/
+			contrib_free(&e->c);
+			e->c.stamp.size = -1;
+			g_cache_have_h = 0;
+			printf("warning ignoring the rest of '%s'\n", path);
+			break;
+		}
+	}
+	fclose(f);
+}
+/**
+Loads the --cache file again if it was replaced since it was
+loaded, which cache_save() always does by renaming over it.
+*/
+static void cache_reload(const char* path) {
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		return;
+	}
+	if ((long)st.st_ino == g_cache_loaded_ino
+		&& (long)st.st_size == g_cache_loaded_size
+		&& (long)st.st_mtime == g_cache_loaded_mtime
+		&& ST_MTIME_NS(st) == g_cache_loaded_mtime_ns) {
+		return;
+	}
+	cache_load(path);
+}
+/**
+Writes the --cache file next to it and then moves it into place,
+so that it is never seen half written.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int cache_save(const char* path) {
+	char tmp[4096];
+	FILE* f;
+	struct cache_entry* e;
+	snprintf(tmp, sizeof tmp, "%s.tmp", path);
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		printf("error cannot open '%s' for writing\n", tmp);
+		return __LINE__;
+	}
+	fprintf(f, "%s\n", s_cache_magic);
+	if (g_cache_have_h) {
+		fprintf(f, "H " HASH64_FMT "\n", g_cache_h.hi, g_cache_h.lo);
+	}
+	else {
+		fputs("H -\n", f);
+	}
+	for (e = g_cache_head; e != NULL; e = e->next) {
+		if (e->c.stamp.size >= 0) {
+			cache_put_entry(f, e->path, e->live, &e->c);
+		}
+	}
+	if (fclose(f) != 0) {
+		remove(tmp);
+		printf("error cannot write '%s'\n", tmp);
+		return __LINE__;
+	}
+#ifndef _POSIX_SOURCE
+	remove(path);
+#endif
+	if (rename(tmp, path) != 0) {
+		remove(tmp);
+		printf("error cannot rename '%s' to '%s'\n", tmp, path);
+		return __LINE__;
+	}
+	return 0;
+}
+
+#ifdef _POSIX_SOURCE
+/**
+Reads all of a file into ram with pread(), the size from fstat()
+only being a hint as the file may be written to meanwhile.
+@param buf
+set to the malloc'ed content
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int src_read_all(const char* path, char** buf, long* len) {
+	struct stat st;
+	long cap;
+	long n = 0;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return __LINE__;
+	}
+	cap = (fstat(fd, &st) == 0 && st.st_size > 0) ? (long)st.st_size + 1 : 4096;
+	*buf = malloc(cap);
+	fail2malloc(*buf, __LINE__);
+	while (1) {
+		ssize_t got = pread(fd, *buf + n, cap - n, n);
+		if (got < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			free(*buf);
+			close(fd);
+			return __LINE__;
+		}
+		if (got == 0) {
+			break;
+		}
+		n += got;
+		if (n == cap) {
+			char* newbuf;
+			cap *= 2;
+			newbuf = realloc(*buf, cap);
+			fail2malloc(newbuf, __LINE__);
+			*buf = newbuf;
+		}
+	}
+	close(fd);
+	*len = n;
+	return 0;
+}
+#endif
+/**
+Records what one source file contributes, see parse_src(), this
+does not touch anything in ram so it is run on any thread.
+@param c
+where to record it
+@param src_c
+the path of the source file
+*/
+static void contrib_scan(struct contrib* c, const char* src_c) {
+	char fname[sizeof g_je_filename];
+#ifdef _POSIX_SOURCE
+	char* buf;
+	long len;
+#else
+	FILE* s;
+#endif
+	src_basename(fname, src_c);
+	contrib_init(c, fname);
+	if (g_cache_path != NULL && cache_lookup(c, src_c)) {
+		return;
+	}
+#ifdef _POSIX_SOURCE
+	/*--one read rather than stdio refilling its buffer--*/
+	if (src_read_all(src_c, &buf, &len) != 0) {
+		c->cant_open = 1;
+		c->ret = __LINE__;
+		return;
+	}
+	contrib_parse_buf(c, buf, len);
+	free(buf);
+#else
+	s = fopen(src_c, "r");
+	if (s == NULL) {
+		c->cant_open = 1;
+		c->ret = __LINE__;
+		return;
+	}
+	c->ret = parse_src(NULL, s, c->fname, c);
+	fclose(s);
+#endif
+}
+
+static char** g_srcs = NULL;
+static int g_num_srcs = 0;
+static int g_srcs_alloced = 0;
+static void add_src(const char* src_c) {
+	if (g_num_srcs == g_srcs_alloced) {
+		char** newsrcs;
+		g_srcs_alloced += 64;
+		newsrcs = realloc(g_srcs, sizeof(char*) * g_srcs_alloced);
+		fail2malloc(newsrcs, __LINE__);
+		g_srcs = newsrcs;
+	}
+	g_srcs[g_num_srcs] = malloc(strlen(src_c) + 1);
+	fail2malloc(g_srcs[g_num_srcs], __LINE__);
+	memcpy(g_srcs[g_num_srcs], src_c, strlen(src_c) + 1);
+	++g_num_srcs;
+}
+/**
+Reads a response file of source file paths, one per line,
+blank lines are skipped.
+@param listfile
+path to the file holding the list
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int add_src_list(const char* listfile) {
+	/*--a path has no limit on how long it is, so neither do these--*/
+	char* pathbuf = NULL;
+	long cap = 0;
+	FILE* f = fopen(listfile, "r");
+	if (f == NULL) {
+		printf("error cannot open '%s' for reading\n", listfile);
+		return __LINE__;
+	}
+	while (get_whole_line(f, &pathbuf, &cap) > 0) {
+		shuffle_trim(pathbuf);
+		if (pathbuf[0] != '\0') {
+			add_src(pathbuf);
+		}
+	}
+	free(pathbuf);
+	fclose(f);
+	return 0;
+}
+
+#if defined(_POSIX_SOURCE) && !defined(JAMES_NO_THREADS)
+#define JAMES_THREADS
+#include <pthread.h>
+#endif
+/*--how many threads parse the source files, see "-j"--*/
+static int g_num_jobs = 1;
+static struct contrib* g_contribs = NULL;
+#ifdef JAMES_THREADS
+static int g_next_contrib = 0;
+static pthread_mutex_t g_next_contrib_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void* contrib_worker(void* arg) {
+	while (1) {
+		int i;
+		pthread_mutex_lock(&g_next_contrib_mutex);
+		i = g_next_contrib;
+		++g_next_contrib;
+		pthread_mutex_unlock(&g_next_contrib_mutex);
+		if (i >= g_num_srcs) {
+			break;
+		}
+		contrib_scan(&g_contribs[i], g_srcs[i]);
+	}
+	return arg;
+}
+#endif
+/*--on Linux the source files are read through io_uring, many opens
+and reads in flight at once with one system call for the lot, each
+file being parsed as soon as it is in ram while the others are
+still being read. Without it, or when the kernel says no, each is
+read with pread() instead. Build with -DJAMES_NO_URING for kernel
+headers older than 5.6. It needs the POSIX headers too, which a
+strict "-std=c99" leaves out--*/
+#if defined(__linux__) && defined(_POSIX_SOURCE) && !defined(JAMES_NO_URING)
+#define JAMES_URING
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+/*--MAP_POPULATE is only there with _DEFAULT_SOURCE, it saves the
+page faults on the rings but they work without it--*/
+#ifdef MAP_POPULATE
+#define URING_MAP_FLAGS (MAP_SHARED | MAP_POPULATE)
+#else
+#define URING_MAP_FLAGS MAP_SHARED
+#endif
+#endif
+#ifdef JAMES_URING
+/*--cleared by --no-uring--*/
+static int g_use_uring = 1;
+/*--files open at once, and fewer files than this are not worth
+setting a ring up for--*/
+#define URING_FILES 64
+#define URING_MIN_FILES 8
+struct uring {
+	int fd;
+	unsigned sq_entries;
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	struct io_uring_sqe* sqes;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	struct io_uring_cqe* cqes;
+	void* sq_ring;
+	size_t sq_ring_len;
+	void* cq_ring;
+	size_t cq_ring_len;
+	size_t sqes_len;
+	unsigned to_submit;
+};
+/**
+Sets up a ring with the raw system calls, as liburing may not be
+there.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int uring_init(struct uring* r, unsigned entries) {
+	struct io_uring_params p;
+	memset(&p, 0, sizeof p);
+	memset(r, 0, sizeof *r);
+	r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0) {
+		return __LINE__;
+	}
+	r->sq_entries = p.sq_entries;
+	r->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sq_ring = mmap(NULL, r->sq_ring_len, PROT_READ | PROT_WRITE,
+		URING_MAP_FLAGS, r->fd, IORING_OFF_SQ_RING);
+	r->cq_ring = mmap(NULL, r->cq_ring_len, PROT_READ | PROT_WRITE,
+		URING_MAP_FLAGS, r->fd, IORING_OFF_CQ_RING);
+	r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+		URING_MAP_FLAGS, r->fd, IORING_OFF_SQES);
+	if (r->sq_ring == MAP_FAILED || r->cq_ring == MAP_FAILED
+		|| r->sqes == MAP_FAILED) {
+		if (r->sq_ring != MAP_FAILED) {
+			munmap(r->sq_ring, r->sq_ring_len);
+		}
+		if (r->cq_ring != MAP_FAILED) {
+			munmap(r->cq_ring, r->cq_ring_len);
+		}
+		if (r->sqes != MAP_FAILED) {
+			munmap(r->sqes, r->sqes_len);
+		}
+		close(r->fd);
+		return __LINE__;
+	}
+	r->sq_head = (unsigned*)((char*)r->sq_ring + p.sq_off.head);
+	r->sq_tail = (unsigned*)((char*)r->sq_ring + p.sq_off.tail);
+	r->sq_mask = (unsigned*)((char*)r->sq_ring + p.sq_off.ring_mask);
+	r->sq_array = (unsigned*)((char*)r->sq_ring + p.sq_off.array);
+	r->cq_head = (unsigned*)((char*)r->cq_ring + p.cq_off.head);
+	r->cq_tail = (unsigned*)((char*)r->cq_ring + p.cq_off.tail);
+	r->cq_mask = (unsigned*)((char*)r->cq_ring + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe*)((char*)r->cq_ring + p.cq_off.cqes);
+	return 0;
+}
+static void uring_free(struct uring* r) {
+	munmap(r->sqes, r->sqes_len);
+	munmap(r->cq_ring, r->cq_ring_len);
+	munmap(r->sq_ring, r->sq_ring_len);
+	close(r->fd);
+}
+/**
+Submits what was queued and waits for at least min_complete
+completions.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int uring_enter(struct uring* r, unsigned min_complete) {
+	while (1) {
+		long got = syscall(__NR_io_uring_enter, r->fd, r->to_submit,
+			min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (got >= 0) {
+			r->to_submit -= (unsigned)got < r->to_submit ? (unsigned)got : r->to_submit;
+			return 0;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			return __LINE__;
+		}
+	}
+}
+/**
+@return the next free submission entry, cleared, submitting what
+is queued first if the ring is full
+*/
+static struct io_uring_sqe* uring_get_sqe(struct uring* r) {
+	unsigned tail = *r->sq_tail;
+	struct io_uring_sqe* sqe;
+	while (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+		uring_enter(r, 0);
+	}
+	sqe = &r->sqes[tail & *r->sq_mask];
+	memset(sqe, 0, sizeof *sqe);
+	r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++r->to_submit;
+	return sqe;
+}
+/*--one file being read, user_data of its operations is its slot,
+closes have none as nobody waits for them--*/
+struct uring_file {
+	int src_i;
+	int fd;
+	char* buf;
+	long cap;
+	long len;
+};
+#define URING_NO_SLOT 0xFFFFFFFFu
+/*--the files read, for the parsing to pick up in the order they
+were done in, src_i of each or -1 if it has to be read the slow
+way as the ring could not--*/
+static char** g_uring_bufs = NULL;
+static long* g_uring_lens = NULL;
+static int* g_uring_ready = NULL;
+static int g_uring_num_ready = 0;
+static int g_uring_next_ready = 0;
+static int g_uring_done = 0;
+#ifdef JAMES_THREADS
+static pthread_mutex_t g_uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_uring_cond = PTHREAD_COND_INITIALIZER;
+#endif
+static void uring_parse(int i) {
+	if (g_uring_bufs[i] == NULL) {
+		/*--the ring could not, so as without it--*/
+		contrib_scan(&g_contribs[i], g_srcs[i]);
+		return;
+	}
+	contrib_parse_buf(&g_contribs[i], g_uring_bufs[i], g_uring_lens[i]);
+	free(g_uring_bufs[i]);
+	g_uring_bufs[i] = NULL;
+}
+static void uring_ready(int i, int inline_parse) {
+	if (inline_parse) {
+		uring_parse(i);
+		return;
+	}
+#ifdef JAMES_THREADS
+	pthread_mutex_lock(&g_uring_mutex);
+	g_uring_ready[g_uring_num_ready] = i;
+	++g_uring_num_ready;
+	pthread_cond_signal(&g_uring_cond);
+	pthread_mutex_unlock(&g_uring_mutex);
+#endif
+}
+#ifdef JAMES_THREADS
+static void* uring_worker(void* arg) {
+	while (1) {
+		int i;
+		pthread_mutex_lock(&g_uring_mutex);
+		while (g_uring_next_ready == g_uring_num_ready && !g_uring_done) {
+			pthread_cond_wait(&g_uring_cond, &g_uring_mutex);
+		}
+		if (g_uring_next_ready == g_uring_num_ready) {
+			pthread_mutex_unlock(&g_uring_mutex);
+			break;
+		}
+		i = g_uring_ready[g_uring_next_ready];
+		++g_uring_next_ready;
+		pthread_mutex_unlock(&g_uring_mutex);
+		uring_parse(i);
+	}
+	return arg;
+}
+#endif
+static void uring_submit_read(struct uring* r, struct uring_file* f, unsigned slot) {
+	struct io_uring_sqe* sqe = uring_get_sqe(r);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = f->fd;
+	sqe->addr = (unsigned long)(f->buf + f->len);
+	sqe->len = (unsigned)(f->cap - f->len);
+	sqe->off = f->len;
+	sqe->user_data = slot;
+}
+static void uring_submit_close(struct uring* r, int fd) {
+	struct io_uring_sqe* sqe = uring_get_sqe(r);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = fd;
+	sqe->user_data = URING_NO_SLOT;
+}
+/**
+Reads every one of g_srcs through a ring on this thread, while
+g_num_jobs - 1 threads parse them as they come, or this one does
+too between reads when there is only one job.
+@return
+0 on okay, otherwise the line number of where the error was tested,
+then nothing was done and they have to be read the usual way
+*/
+static int uring_scan_all(void) {
+	struct uring r;
+	struct uring_file files[URING_FILES];
+	unsigned free_slots[URING_FILES];
+	int num_free = URING_FILES;
+	int next = 0;
+	int done = 0;
+	int i;
+	int inline_parse = 1;
+#ifdef JAMES_THREADS
+	pthread_t* threads = NULL;
+	int num_threads = g_num_jobs;
+	int started = 0;
+#endif
+	if (!g_use_uring || g_num_srcs < URING_MIN_FILES || g_cache_path != NULL) {
+		return __LINE__;
+	}
+	/*--room for an open or read and a close for every file--*/
+	if (uring_init(&r, URING_FILES * 4) != 0) {
+		return __LINE__;
+	}
+	g_uring_bufs = malloc(sizeof(char*) * g_num_srcs);
+	fail2malloc(g_uring_bufs, __LINE__);
+	g_uring_lens = malloc(sizeof(long) * g_num_srcs);
+	fail2malloc(g_uring_lens, __LINE__);
+	g_uring_ready = malloc(sizeof(int) * g_num_srcs);
+	fail2malloc(g_uring_ready, __LINE__);
+	g_uring_num_ready = 0;
+	g_uring_next_ready = 0;
+	g_uring_done = 0;
+	for (i = 0; i < g_num_srcs; ++i) {
+		char fname[sizeof g_je_filename];
+		src_basename(fname, g_srcs[i]);
+		contrib_init(&g_contribs[i], fname);
+		g_uring_bufs[i] = NULL;
+	}
+	for (i = 0; i < URING_FILES; ++i) {
+		free_slots[i] = URING_FILES - 1 - i;
+		files[i].src_i = -1;
+	}
+#ifdef JAMES_THREADS
+	if (num_threads <= 0) {
+		num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (num_threads > 1) {
+		/*--this thread reads, the others parse--*/
+		threads = malloc(sizeof(pthread_t) * num_threads);
+		fail2malloc(threads, __LINE__);
+		for (i = 1; i < num_threads; ++i) {
+			if (pthread_create(&threads[i], NULL, uring_worker, NULL) != 0) {
+				break;
+			}
+			started = i;
+		}
+		inline_parse = started == 0;
+	}
+#endif
+	while (done < g_num_srcs) {
+		unsigned head;
+		unsigned tail;
+		/*--open as many as there are slots for--*/
+		while (num_free > 0 && next < g_num_srcs) {
+			unsigned slot = free_slots[--num_free];
+			struct io_uring_sqe* sqe = uring_get_sqe(&r);
+			files[slot].src_i = next;
+			files[slot].fd = -1;
+			files[slot].buf = NULL;
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (unsigned long)g_srcs[next];
+			sqe->open_flags = O_RDONLY;
+			sqe->user_data = slot;
+			++next;
+		}
+		if (uring_enter(&r, 1) != 0) {
+			break;
+		}
+		head = *r.cq_head;
+		tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			struct io_uring_cqe* cqe = &r.cqes[head & *r.cq_mask];
+			unsigned slot = (unsigned)cqe->user_data;
+			int res = cqe->res;
+			struct uring_file* f;
+			int finished = 0;
+			if (slot == URING_NO_SLOT) {
+				continue;
+			}
+			f = &files[slot];
+			if (f->fd < 0) {
+				/*--the open is done--*/
+				if (res < 0) {
+					finished = 1;
+				}
+				else {
+					f->fd = res;
+					f->cap = 16384;
+					f->len = 0;
+					f->buf = malloc(f->cap);
+					fail2malloc(f->buf, __LINE__);
+					uring_submit_read(&r, f, slot);
+				}
+			}
+			else if (res < 0) {
+				free(f->buf);
+				f->buf = NULL;
+				finished = 1;
+			}
+			else if (res == 0) {
+				g_uring_bufs[f->src_i] = f->buf;
+				g_uring_lens[f->src_i] = f->len;
+				finished = 1;
+			}
+			else {
+				/*--read on until there is no more--*/
+				f->len += res;
+				if (f->len == f->cap) {
+					char* newbuf;
+					f->cap *= 2;
+					newbuf = realloc(f->buf, f->cap);
+					fail2malloc(newbuf, __LINE__);
+					f->buf = newbuf;
+				}
+				uring_submit_read(&r, f, slot);
+			}
+			if (finished) {
+				if (f->fd >= 0) {
+					uring_submit_close(&r, f->fd);
+				}
+				free_slots[num_free++] = slot;
+				++done;
+				uring_ready(f->src_i, inline_parse);
+				f->src_i = -1;
+			}
+		}
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+	}
+	/*--let the closes go through--*/
+	uring_enter(&r, 0);
+	uring_free(&r);
+	if (done < g_num_srcs) {
+		/*--the ring broke down, the rest the slow way--*/
+		for (i = 0; i < URING_FILES; ++i) {
+			if (files[i].src_i >= 0) {
+				if (files[i].fd >= 0) {
+					close(files[i].fd);
+				}
+				free(files[i].buf);
+				uring_ready(files[i].src_i, inline_parse);
+			}
+		}
+		for (; next < g_num_srcs; ++next) {
+			uring_ready(next, inline_parse);
+		}
+	}
+#ifdef JAMES_THREADS
+	if (threads != NULL) {
+		pthread_mutex_lock(&g_uring_mutex);
+		g_uring_done = 1;
+		pthread_cond_broadcast(&g_uring_cond);
+		pthread_mutex_unlock(&g_uring_mutex);
+		for (i = 1; i <= started; ++i) {
+			pthread_join(threads[i], NULL);
+		}
+		free(threads);
+	}
+#endif
+	free(g_uring_bufs);
+	free(g_uring_lens);
+	free(g_uring_ready);
+	return 0;
+}
+#endif
+/**
+Records what all of the source files contribute into g_contribs,
+using g_num_jobs threads where there are threads. This needs no
+lock, as nothing shared is changed.
+*/
+static void contrib_scan_all(void) {
+#ifdef JAMES_THREADS
+	pthread_t* threads;
+	int num_threads = g_num_jobs;
+	int t;
+	int started = 0;
+#endif
+	if (g_contribs != NULL || g_num_srcs == 0) {
+		/*--already read from the fragments, see --merge--*/
+		return;
+	}
+	g_contribs = malloc(sizeof(struct contrib) * g_num_srcs);
+	fail2malloc(g_contribs, __LINE__);
+#ifdef JAMES_URING
+	if (uring_scan_all() == 0) {
+		return;
+	}
+#endif
+#ifdef JAMES_THREADS
+	if (num_threads <= 0) {
+		num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (num_threads > g_num_srcs) {
+		num_threads = g_num_srcs;
+	}
+	threads = malloc(sizeof(pthread_t) * (num_threads > 1 ? num_threads : 1));
+	fail2malloc(threads, __LINE__);
+	g_next_contrib = 0;
+	/*--this thread is one of the workers too--*/
+	for (t = 1; t < num_threads; ++t) {
+		if (pthread_create(&threads[t], NULL, contrib_worker, NULL) != 0) {
+			break;
+		}
+		started = t;
+	}
+	contrib_worker(NULL);
+	for (t = 1; t <= started; ++t) {
+		pthread_join(threads[t], NULL);
+	}
+	free(threads);
+#else
+	{
+		int i;
+		for (i = 0; i < g_num_srcs; ++i) {
+			contrib_scan(&g_contribs[i], g_srcs[i]);
+		}
+	}
+#endif
+}
+
+/*--with --scan-dir the source files are found by walking folders
+rather than named one by one, with "-j" threads where there are
+threads, and then taken in the order of their paths so that it is
+the same every time no matter how the walk went--*/
+#ifdef _POSIX_SOURCE
+#include <dirent.h>
+#endif
+static const char* g_scan_dirs[64];
+static int g_num_scan_dirs = 0;
+static const char* g_scan_includes[64];
+static int g_num_scan_includes = 0;
+static const char* g_scan_excludes[64];
+static int g_num_scan_excludes = 0;
+/*--bigger files are skipped as they are hardly hand written, 0 for
+no limit, see --max-size--*/
+static long g_scan_max_size = 16L * 1024 * 1024;
+/*--the --shard-dir folder is not walked, should it be in there--*/
+static char g_scan_skip_dir[4096];
+static const char* g_scan_skip_name = NULL;
+/**
+@return whether the paths a and b are the same file
+*/
+static int same_file(const char* a, const char* b) {
+#ifdef _POSIX_SOURCE
+	struct stat sa;
+	struct stat sb;
+	return stat(a, &sa) == 0 && stat(b, &sb) == 0
+		&& sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#elif defined(_MSC_VER)
+	char fa[4096];
+	char fb[4096];
+	return GetFullPathNameA(a, sizeof fa, fa, NULL) != 0
+		&& GetFullPathNameA(b, sizeof fb, fb, NULL) != 0
+		&& _stricmp(fa, fb) == 0;
+#else
+	return strcmp(a, b) == 0;
+#endif
+}
+/*--what the source files are called when there is no --include--*/
+static const char* s_source_exts[] = { ".c", ".h", ".cc", ".cpp", ".cxx",
+	".hh", ".hpp", ".hxx", ".inl", NULL };
+/**
+@return whether name looks like a source file james should read
+*/
+static int is_source_name(const char* name) {
+	const char* dot = strrchr(name, '.');
+	int i;
+	if (dot == NULL) {
+		return 0;
+	}
+	for (i = 0; s_source_exts[i] != NULL; ++i) {
+		if (strcmp(dot, s_source_exts[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+/**
+Matches name against pat, where "*" and "?" match anything but
+"/", "**" also matches "/", and "**" followed by "/" also matches
+no folder at all.
+@return 1 if it matches, otherwise 0
+*/
+static int glob_match(const char* pat, const char* name) {
+	while (*pat != '\0') {
+		if (pat[0] == '*' && pat[1] == '*') {
+			pat += 2;
+			if (*pat == '/' && glob_match(pat + 1, name)) {
+				return 1;
+			}
+			for (;; ++name) {
+				if (glob_match(pat, name)) {
+					return 1;
+				}
+				if (*name == '\0') {
+					return 0;
+				}
+			}
+		}
+		if (*pat == '*') {
+			++pat;
+			for (;; ++name) {
+				if (glob_match(pat, name)) {
+					return 1;
+				}
+				if (*name == '\0' || *name == '/') {
+					return 0;
+				}
+			}
+		}
+		if (*name == '\0' || (*name == '/' && *pat != '/')
+			|| (*pat != '?' && *pat != *name)) {
+			return 0;
+		}
+		++pat;
+		++name;
+	}
+	return *name == '\0';
+}
+/**
+Patterns with a "/" in them are matched against the path from the
+folder being scanned, those without against the file name only.
+@return 1 if any of the patterns match, otherwise 0
+*/
+static int glob_match_any(const char** pats, int num_pats, const char* rel,
+	const char* base) {
+	int i;
+	for (i = 0; i < num_pats; ++i) {
+		if (glob_match(pats[i], strchr(pats[i], '/') ? rel : base)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+/**
+@return whether the folder rel should be walked
+*/
+static int scan_want_dir(const char* rel, const char* base) {
+	char slashed[4096];
+	/*--a pattern ending in "/" and two stars should keep out the
+	folder itself too--*/
+	snprintf(slashed, sizeof slashed, "%s/", rel);
+	return !glob_match_any(g_scan_excludes, g_num_scan_excludes, rel, base)
+		&& !glob_match_any(g_scan_excludes, g_num_scan_excludes, slashed, base);
+}
+/**
+@return whether the file rel should be read, leaving its size out
+*/
+static int scan_want_file(const char* rel, const char* base) {
+	if (g_num_scan_includes > 0) {
+		if (!glob_match_any(g_scan_includes, g_num_scan_includes, rel, base)) {
+			return 0;
+		}
+	}
+	else if (!is_source_name(base)) {
+		return 0;
+	}
+	return !glob_match_any(g_scan_excludes, g_num_scan_excludes, rel, base);
+}
+/*--the folders still to be read, and the source files found, each
+path followed by where the part from the scanned folder starts--*/
+struct scan_path {
+	char* path;
+	int rel_at;
+};
+static struct scan_path* g_scan_queue = NULL;
+static int g_num_scan_queue = 0;
+static int g_scan_queue_alloced = 0;
+static char** g_scan_found = NULL;
+static int g_num_scan_found = 0;
+static int g_scan_found_alloced = 0;
+#ifdef JAMES_THREADS
+static pthread_mutex_t g_scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_scan_cond = PTHREAD_COND_INITIALIZER;
+/*--how many workers are reading a folder, so could add more--*/
+static int g_scan_busy = 0;
+#endif
+static void scan_push_dir(const char* path, int rel_at) {
+#ifdef JAMES_THREADS
+	pthread_mutex_lock(&g_scan_mutex);
+#endif
+	if (g_num_scan_queue == g_scan_queue_alloced) {
+		struct scan_path* newqueue;
+		g_scan_queue_alloced += 64;
+		newqueue = realloc(g_scan_queue, sizeof(struct scan_path) * g_scan_queue_alloced);
+		fail2malloc(newqueue, __LINE__);
+		g_scan_queue = newqueue;
+	}
+	g_scan_queue[g_num_scan_queue].path = malloc(strlen(path) + 1);
+	fail2malloc(g_scan_queue[g_num_scan_queue].path, __LINE__);
+	memcpy(g_scan_queue[g_num_scan_queue].path, path, strlen(path) + 1);
+	g_scan_queue[g_num_scan_queue].rel_at = rel_at;
+	++g_num_scan_queue;
+#ifdef JAMES_THREADS
+	pthread_cond_signal(&g_scan_cond);
+	pthread_mutex_unlock(&g_scan_mutex);
+#endif
+}
+static void scan_push_found(const char* path) {
+#ifdef JAMES_THREADS
+	pthread_mutex_lock(&g_scan_mutex);
+#endif
+	if (g_num_scan_found == g_scan_found_alloced) {
+		char** newfound;
+		g_scan_found_alloced += 256;
+		newfound = realloc(g_scan_found, sizeof(char*) * g_scan_found_alloced);
+		fail2malloc(newfound, __LINE__);
+		g_scan_found = newfound;
+	}
+	g_scan_found[g_num_scan_found] = malloc(strlen(path) + 1);
+	fail2malloc(g_scan_found[g_num_scan_found], __LINE__);
+	memcpy(g_scan_found[g_num_scan_found], path, strlen(path) + 1);
+	++g_num_scan_found;
+#ifdef JAMES_THREADS
+	pthread_mutex_unlock(&g_scan_mutex);
+#endif
+}
+/**
+Reads one folder, queueing the folders in it and keeping the
+source files wanted. Names starting with "." and symbolic links
+are skipped.
+*/
+static void scan_read_dir(const char* dir, int rel_at) {
+	char path[4096];
+	const char* name;
+	int is_dir;
+	int is_file;
+	long size;
+#ifdef _POSIX_SOURCE
+	struct dirent* de;
+	DIR* d = opendir(dir);
+	if (d == NULL) {
+		printf("error cannot open folder '%s'\n", dir);
+		return;
+	}
+	while ((de = readdir(d)) != NULL) {
+		struct stat st;
+		name = de->d_name;
+		if (name[0] == '.') {
+			continue;
+		}
+		snprintf(path, sizeof path, "%s/%s", dir, name);
+		size = -1;
+#ifdef _DIRENT_HAVE_D_TYPE
+		/*--saves a stat for every name in the tree--*/
+		if (de->d_type != DT_UNKNOWN) {
+			is_dir = de->d_type == DT_DIR;
+			is_file = de->d_type == DT_REG;
+		}
+		else
+#endif
+		{
+			if (lstat(path, &st) != 0) {
+				continue;
+			}
+			is_dir = S_ISDIR(st.st_mode);
+			is_file = S_ISREG(st.st_mode);
+			size = (long)st.st_size;
+		}
+#elif defined(_MSC_VER)
+	WIN32_FIND_DATAA fd;
+	HANDLE d;
+	snprintf(path, sizeof path, "%s\\*", dir);
+	d = FindFirstFileA(path, &fd);
+	if (d == INVALID_HANDLE_VALUE) {
+		printf("error cannot open folder '%s'\n", dir);
+		return;
+	}
+	do {
+		name = fd.cFileName;
+		if (name[0] == '.') {
+			continue;
+		}
+		snprintf(path, sizeof path, "%s/%s", dir, name);
+		is_dir = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0
+			&& (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0;
+		is_file = (fd.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY
+			| FILE_ATTRIBUTE_REPARSE_POINT)) == 0;
+		size = (fd.nFileSizeHigh != 0) ? LONG_MAX : (long)fd.nFileSizeLow;
+#else
+	(void)dir;
+	puts("error --scan-dir needs POSIX or Windows");
+	while (0) {
+		name = NULL;
+		is_dir = 0;
+		is_file = 0;
+		size = -1;
+		path[0] = '\0';
+#endif
+		if (is_dir && g_scan_skip_name != NULL
+			&& strcmp(name, g_scan_skip_name) == 0
+			&& same_file(path, g_scan_skip_dir)) {
+			continue;
+		}
+		if (is_dir && scan_want_dir(path + rel_at, name)) {
+			scan_push_dir(path, rel_at);
+		}
+		else if (is_file && scan_want_file(path + rel_at, name)) {
+#ifdef _POSIX_SOURCE
+			if (g_scan_max_size > 0 && size < 0) {
+				size = (stat(path, &st) == 0) ? (long)st.st_size : 0;
+			}
+#endif
+			if (g_scan_max_size <= 0 || size <= g_scan_max_size) {
+				scan_push_found(path);
+			}
+		}
+#ifdef _POSIX_SOURCE
+	}
+	closedir(d);
+#elif defined(_MSC_VER)
+	} while (FindNextFileA(d, &fd));
+	FindClose(d);
+#else
+	}
+#endif
+}
+#ifdef JAMES_THREADS
+static void* scan_worker(void* arg) {
+	while (1) {
+		struct scan_path next;
+		pthread_mutex_lock(&g_scan_mutex);
+		while (g_num_scan_queue == 0 && g_scan_busy > 0) {
+			pthread_cond_wait(&g_scan_cond, &g_scan_mutex);
+		}
+		if (g_num_scan_queue == 0) {
+			/*--nothing left and nobody can add more--*/
+			pthread_cond_broadcast(&g_scan_cond);
+			pthread_mutex_unlock(&g_scan_mutex);
+			break;
+		}
+		--g_num_scan_queue;
+		next = g_scan_queue[g_num_scan_queue];
+		++g_scan_busy;
+		pthread_mutex_unlock(&g_scan_mutex);
+		scan_read_dir(next.path, next.rel_at);
+		free(next.path);
+		pthread_mutex_lock(&g_scan_mutex);
+		--g_scan_busy;
+		pthread_cond_broadcast(&g_scan_cond);
+		pthread_mutex_unlock(&g_scan_mutex);
+	}
+	return arg;
+}
+#endif
+static int scan_found_cmp(const void* a, const void* b) {
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+/**
+Walks every --scan-dir folder and adds the source files found to
+g_srcs, after any named on the command line, in the order of
+their paths. james.h itself is left out, should it be in there.
+@param james_h_opt
+the james.h being made, or NULL with --spool
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int scan_dirs(const char* james_h_opt) {
+	int i;
+	const char* own_name = NULL;
+	if (james_h_opt != NULL) {
+		own_name = strrchr(james_h_opt, '/');
+		if (strrchr(james_h_opt, '\\') > own_name) {
+			own_name = strrchr(james_h_opt, '\\');
+		}
+		own_name = (own_name != NULL) ? own_name + 1 : james_h_opt;
+		if (g_shard_dir != NULL) {
+			shard_set_base(james_h_opt);
+			snprintf(g_scan_skip_dir, sizeof g_scan_skip_dir, "%s", g_shard_base);
+			g_scan_skip_name = strrchr(g_shard_base, '/');
+			g_scan_skip_name = (g_scan_skip_name != NULL) ? g_scan_skip_name + 1 : g_shard_base;
+		}
+	}
+	for (i = 0; i < g_num_scan_dirs; ++i) {
+		char root[4096];
+		int n = snprintf(root, sizeof root, "%s", g_scan_dirs[i]);
+		/*--"src/" and "src" should give the same paths--*/
+		while (n > 1 && (root[n - 1] == '/' || root[n - 1] == '\\')) {
+			root[--n] = '\0';
+		}
+		scan_push_dir(root, n + 1);
+	}
+#ifdef JAMES_THREADS
+	{
+		pthread_t* threads;
+		int num_threads = g_num_jobs;
+		int t;
+		int started = 0;
+		if (num_threads <= 0) {
+			num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		}
+		threads = malloc(sizeof(pthread_t) * (num_threads > 1 ? num_threads : 1));
+		fail2malloc(threads, __LINE__);
+		g_scan_busy = 0;
+		/*--this thread is one of the workers too--*/
+		for (t = 1; t < num_threads; ++t) {
+			if (pthread_create(&threads[t], NULL, scan_worker, NULL) != 0) {
+				break;
+			}
+			started = t;
+		}
+		scan_worker(NULL);
+		for (t = 1; t <= started; ++t) {
+			pthread_join(threads[t], NULL);
+		}
+		free(threads);
+	}
+#else
+	while (g_num_scan_queue > 0) {
+		struct scan_path next;
+		--g_num_scan_queue;
+		next = g_scan_queue[g_num_scan_queue];
+		scan_read_dir(next.path, next.rel_at);
+		free(next.path);
+	}
+#endif
+	qsort(g_scan_found, g_num_scan_found, sizeof(char*), scan_found_cmp);
+	for (i = 0; i < g_num_scan_found; ++i) {
+		const char* found = g_scan_found[i];
+		const char* base = strrchr(found, '/');
+		base = (base != NULL) ? base + 1 : found;
+		if (own_name == NULL || strcmp(base, own_name) != 0
+			|| !same_file(found, james_h_opt)) {
+			add_src(found);
+		}
+		free(g_scan_found[i]);
+	}
+	free(g_scan_found);
+	g_scan_found = NULL;
+	g_num_scan_found = 0;
+	g_scan_found_alloced = 0;
+	return 0;
+}
+#endif
+
+/*--james.h.state is a binary snapshot of what is in ram once
+james.h has been written, so the next run loads it in one go
+instead of parsing the ram dump in james.h again. It is only
+trusted while james.h still has the hash it was written with.
+It is written in the byte order of the machine, a different one
+just means falling back to parsing james.h. Its generation goes
+up by one each time james.h is written, see --optimistic--*/
+static const char s_state_magic[8] = { 'J','A','M','E','S','S','T','\n' };
+#define STATE_VERSION 3
+#define STATE_BYTE_ORDER 0x01020304u
+#define STATE_NULL 0xFFFFFFFFu
+/*--magic, version, byte order, hash of james.h, generation--*/
+#define STATE_HEAD_LEN (8 + 4 + 4 + 8 + 4)
+/*--a struct hash64 takes 8 bytes, the high half first--*/
+#define STATE_HASH_LEN 8
+static void state_hash_to(unsigned char* at, struct hash64 h) {
+	unsigned int w[2];
+	w[0] = (unsigned int)h.hi;
+	w[1] = (unsigned int)h.lo;
+	memcpy(at, w, sizeof w);
+}
+static struct hash64 state_hash_from(const unsigned char* at) {
+	unsigned int w[2];
+	struct hash64 h;
+	memcpy(w, at, sizeof w);
+	h.hi = w[0];
+	h.lo = w[1];
+	return h;
+}
+struct state_out {
+	FILE* f;
+	struct hash64 sum;
+};
+static void state_put(struct state_out* o, const void* data, size_t n) {
+	fwrite(data, 1, n, o->f);
+	o->sum = fnv1a(o->sum, (const unsigned char*)data, (long)n);
+}
+static void state_put_u32(struct state_out* o, unsigned int v) {
+	state_put(o, &v, sizeof v);
+}
+static void state_put_str(struct state_out* o, const char* str) {
+	if (str == NULL) {
+		state_put_u32(o, STATE_NULL);
+		return;
+	}
+	state_put_u32(o, (unsigned int)strlen(str));
+	state_put(o, str, strlen(str));
+}
+/**
+Reads only the generation of james.h.state.
+@return
+the generation, or 0 if there is no james.h.state
+*/
+static unsigned long state_peek_generation(const char* james_h) {
+	char path[4096];
+	unsigned char head[STATE_HEAD_LEN];
+	unsigned int generation = 0;
+	FILE* f;
+	snprintf(path, sizeof path, "%s.state", james_h);
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		return 0;
+	}
+	if (fread(head, 1, sizeof head, f) == sizeof head
+		&& memcmp(head, s_state_magic, sizeof s_state_magic) == 0) {
+		unsigned int version;
+		unsigned int order;
+		memcpy(&version, head + 8, sizeof version);
+		memcpy(&order, head + 12, sizeof order);
+		/*--from another version or machine it may be laid out
+		differently, so it says nothing--*/
+		if (version == STATE_VERSION && order == STATE_BYTE_ORDER) {
+			memcpy(&generation, head + 24, sizeof generation);
+		}
+	}
+	fclose(f);
+	return generation;
+}
+/**
+Writes james.h.state for the james.h just committed, from what
+is in ram.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int state_save(const char* james_h) {
+	char path[4096];
+	char tmp[4096];
+	unsigned char head[STATE_HEAD_LEN];
+	unsigned char sum[STATE_HASH_LEN];
+	unsigned int version = STATE_VERSION;
+	unsigned int order = STATE_BYTE_ORDER;
+	struct hash64 h;
+	unsigned int generation = (unsigned int)state_peek_generation(james_h) + 1;
+	unsigned int n;
+	struct state_out o;
+	struct list* l;
+	struct alias_plus* ap;
+	struct ap_invocation* inv;
+	snprintf(path, sizeof path, "%s.state", james_h);
+	snprintf(tmp, sizeof tmp, "%s.state.tmp", james_h);
+	if (file_hash(james_h, &h) != 0) {
+		remove(path);
+		return __LINE__;
+	}
+	o.f = fopen(tmp, "wb");
+	if (o.f == NULL) {
+		printf("error cannot open '%s' for writing\n", tmp);
+		return __LINE__;
+	}
+	memcpy(head, s_state_magic, sizeof s_state_magic);
+	memcpy(head + 8, &version, sizeof version);
+	memcpy(head + 12, &order, sizeof order);
+	state_hash_to(head + 16, h);
+	memcpy(head + 24, &generation, sizeof generation);
+	fwrite(head, 1, sizeof head, o.f);
+	o.sum = s_fnv1a_init;
+
+	for (n = 0, l = first_list; l != NULL; l = l->next_list) {
+		++n;
+	}
+	state_put_u32(&o, n);
+	for (l = first_list; l != NULL; l = l->next_list) {
+		struct list_item* y;
+		state_put_str(&o, l->name);
+		for (n = 0, y = l->head; y != NULL; y = y->next) {
+			++n;
+		}
+		state_put_u32(&o, n);
+		for (y = l->head; y != NULL; y = y->next) {
+			state_put_str(&o, y->value);
+			state_put_str(&o, y->fname);
+			state_put_u32(&o, (unsigned int)y->lineno);
+		}
+	}
+
+	/*--the same ones as the ram dump has, so nameless ones not--*/
+	for (n = 0, ap = alias_plus_head; ap != NULL; ap = ap->next) {
+		if (strlen(ap->name) > 0) {
+			++n;
+		}
+	}
+	state_put_u32(&o, n);
+	for (ap = alias_plus_head; ap != NULL; ap = ap->next) {
+		struct alias_positional* pos;
+		struct alias_plus_macroline* ml;
+		int i;
+		if (strlen(ap->name) == 0) {
+			continue;
+		}
+		state_put_str(&o, ap->name);
+		state_put_u32(&o, (unsigned int)ap->numPositionals);
+		for (n = 0, pos = ap->head; pos != NULL; pos = pos->next) {
+			++n;
+		}
+		state_put_u32(&o, n);
+		for (pos = ap->head; pos != NULL; pos = pos->next) {
+			state_put_u32(&o, (unsigned char)pos->varLetter);
+			state_put_u32(&o, (unsigned int)pos->posNum);
+		}
+		state_put_u32(&o, ap->alsoPlus != NULL ? (unsigned int)ap->alsoPlusNum : 0);
+		for (i = 0; ap->alsoPlus != NULL && i < ap->alsoPlusNum; ++i) {
+			state_put_str(&o, ap->alsoPlus[i]);
+		}
+		state_put_str(&o, ap->define_output_name);
+		for (n = 0, ml = ap->macro_lines; ml != NULL; ml = ml->next) {
+			++n;
+		}
+		state_put_u32(&o, n);
+		for (ml = ap->macro_lines; ml != NULL; ml = ml->next) {
+			state_put_str(&o, ml->line);
+		}
+	}
+
+	for (n = 0, inv = ap_inv_head; inv != NULL; inv = inv->next) {
+		++n;
+	}
+	state_put_u32(&o, n);
+	for (inv = ap_inv_head; inv != NULL; inv = inv->next) {
+		int i;
+		state_put_str(&o, inv->name);
+		state_put_str(&o, inv->fname);
+		state_put_u32(&o, (unsigned int)inv->lineno);
+		state_put_u32(&o, (unsigned int)inv->argc);
+		for (i = 0; i < inv->argc; ++i) {
+			state_put_str(&o, inv->argv[i]);
+		}
+	}
+
+	state_hash_to(sum, o.sum);
+	fwrite(sum, 1, sizeof sum, o.f);
+	if (fclose(o.f) != 0) {
+		remove(tmp);
+		printf("error cannot write '%s'\n", tmp);
+		return __LINE__;
+	}
+#ifndef _POSIX_SOURCE
+	remove(path);
+#endif
+	if (rename(tmp, path) != 0) {
+		remove(tmp);
+		printf("error cannot rename '%s' to '%s'\n", tmp, path);
+		return __LINE__;
+	}
+	return 0;
+}
+
+struct state_in {
+	const unsigned char* p;
+	const unsigned char* end;
+	/*--0 only checks it can all be read, 1 puts it into ram--*/
+	int build;
+};
+static int state_get(struct state_in* in, void* out, size_t n) {
+	if ((size_t)(in->end - in->p) < n) {
+		return __LINE__;
+	}
+	memcpy(out, in->p, n);
+	in->p += n;
+	return 0;
+}
+static int state_get_u32(struct state_in* in, unsigned int* v) {
+	return state_get(in, v, sizeof *v);
+}
+static int state_get_str(struct state_in* in, char** out) {
+	unsigned int n;
+	*out = NULL;
+	if (state_get_u32(in, &n) != 0) {
+		return __LINE__;
+	}
+	if (n == STATE_NULL) {
+		return 0;
+	}
+	if ((size_t)(in->end - in->p) < n) {
+		return __LINE__;
+	}
+	if (in->build) {
+		*out = malloc(n + 1);
+		fail2malloc(*out, __LINE__);
+		memcpy(*out, in->p, n);
+		(*out)[n] = '\0';
+	}
+	in->p += n;
+	return 0;
+}
+/**
+Same as state_get_str() for a name, which cannot be NULL, checked
+also when only checking that it can all be read.
+*/
+static int state_get_name(struct state_in* in, char** out) {
+	const unsigned char* at = in->p;
+	unsigned int n;
+	if (state_get_u32(in, &n) != 0 || n == STATE_NULL) {
+		return __LINE__;
+	}
+	in->p = at;
+	return state_get_str(in, out);
+}
+/**
+Reads the lists, alias pluses and invocations of a snapshot, see
+state_save(), putting them into ram only when in->build.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int state_read(struct state_in* in) {
+	unsigned int n, i, k, m;
+	struct list* last_list = NULL;
+	struct alias_plus* last_ap = NULL;
+	struct ap_invocation* last_inv = NULL;
+
+	if (state_get_u32(in, &n)) {
+		return __LINE__;
+	}
+	for (i = 0; i < n; ++i) {
+		struct list* l = NULL;
+		struct list_item* last_y = NULL;
+		char* name;
+		if (state_get_name(in, &name)) {
+			return __LINE__;
+		}
+		if (in->build) {
+			l = malloc(sizeof(struct list));
+			fail2malloc(l, __LINE__);
+			l->name = name;
+			l->head = NULL;
+			l->next_list = NULL;
+			if (last_list == NULL) {
+				first_list = l;
+			}
+			else {
+				last_list->next_list = l;
+			}
+			last_list = l;
+		}
+		if (state_get_u32(in, &m)) {
+			return __LINE__;
+		}
+		for (k = 0; k < m; ++k) {
+			struct list_item* y = NULL;
+			char* value;
+			char* fn;
+			unsigned int ln;
+			if (state_get_str(in, &value)) {
+				return __LINE__;
+			}
+			if (state_get_str(in, &fn)) {
+				return __LINE__;
+			}
+			if (state_get_u32(in, &ln)) {
+				return __LINE__;
+			}
+			if (!in->build) {
+				continue;
+			}
+			y = malloc(sizeof(struct list_item));
+			fail2malloc(y, __LINE__);
+			y->value = value;
+			y->fname[0] = '\0';
+			if (fn != NULL) {
+				src_basename(y->fname, fn);
+				free(fn);
+			}
+			y->lineno = (int)ln;
+			y->next = NULL;
+			if (last_y == NULL) {
+				l->head = y;
+			}
+			else {
+				last_y->next = y;
+			}
+			last_y = y;
+		}
+	}
+
+	if (state_get_u32(in, &n)) {
+		return __LINE__;
+	}
+	for (i = 0; i < n; ++i) {
+		struct alias_plus* ap = NULL;
+		struct alias_positional* last_pos = NULL;
+		struct alias_plus_macroline* last_ml = NULL;
+		char* name;
+		unsigned int num;
+		if (state_get_name(in, &name)) {
+			return __LINE__;
+		}
+		if (in->build) {
+			ap = alias_plus_newx(name, (int)strlen(name));
+			free(name);
+			if (last_ap == NULL) {
+				alias_plus_head = ap;
+			}
+			else {
+				last_ap->next = ap;
+			}
+			if (alias_plus_buckets != NULL) {
+				alias_plus_index_add(ap);
+			}
+			last_ap = ap;
+		}
+		if (state_get_u32(in, &num)) {
+			return __LINE__;
+		}
+		if (in->build) {
+			ap->numPositionals = (int)num;
+		}
+		if (state_get_u32(in, &m)) {
+			return __LINE__;
+		}
+		for (k = 0; k < m; ++k) {
+			struct alias_positional* pos;
+			unsigned int letter, posnum;
+			if (state_get_u32(in, &letter)) {
+				return __LINE__;
+			}
+			if (state_get_u32(in, &posnum)) {
+				return __LINE__;
+			}
+			if (!in->build) {
+				continue;
+			}
+			pos = malloc(sizeof(struct alias_positional));
+			fail2malloc(pos, __LINE__);
+			pos->varLetter = (char)letter;
+			pos->posNum = (int)posnum;
+			pos->next = NULL;
+			if (last_pos == NULL) {
+				ap->head = pos;
+			}
+			else {
+				last_pos->next = pos;
+			}
+			last_pos = pos;
+		}
+		if (state_get_u32(in, &m)) {
+			return __LINE__;
+		}
+		if ((size_t)(in->end - in->p) / 4 < m) {
+			return __LINE__;
+		}
+		if (in->build) {
+			ap->alsoPlusNum = (int)m;
+			if (m > 0) {
+				ap->alsoPlus = malloc(sizeof(char*) * m);
+				fail2malloc(ap->alsoPlus, __LINE__);
+			}
+		}
+		for (k = 0; k < m; ++k) {
+			char* also;
+			if (state_get_str(in, &also)) {
+				return __LINE__;
+			}
+			if (in->build) {
+				ap->alsoPlus[k] = also;
+			}
+		}
+		{
+			char* define_output_name;
+			if (state_get_str(in, &define_output_name)) {
+				return __LINE__;
+			}
+			if (in->build) {
+				ap->define_output_name = define_output_name;
+			}
+		}
+		if (state_get_u32(in, &m)) {
+			return __LINE__;
+		}
+		for (k = 0; k < m; ++k) {
+			struct alias_plus_macroline* ml;
+			char* line;
+			if (state_get_str(in, &line)) {
+				return __LINE__;
+			}
+			if (!in->build) {
+				continue;
+			}
+			ml = malloc(sizeof(struct alias_plus_macroline));
+			fail2malloc(ml, __LINE__);
+			ml->line = line;
+			ml->next = NULL;
+			if (last_ml == NULL) {
+				ap->macro_lines = ml;
+			}
+			else {
+				last_ml->next = ml;
+			}
+			last_ml = ml;
+		}
+	}
+
+	if (state_get_u32(in, &n)) {
+		return __LINE__;
+	}
+	for (i = 0; i < n; ++i) {
+		struct ap_invocation* inv = NULL;
+		char* name;
+		char* fn;
+		unsigned int ln, argc;
+		if (state_get_name(in, &name)) {
+			return __LINE__;
+		}
+		if (state_get_str(in, &fn)) {
+			return __LINE__;
+		}
+		if (state_get_u32(in, &ln)) {
+			return __LINE__;
+		}
+		if (state_get_u32(in, &argc)) {
+			return __LINE__;
+		}
+		if ((size_t)(in->end - in->p) / 4 < argc) {
+			return __LINE__;
+		}
+		if (in->build) {
+			inv = ap_inv_create(name, -1);
+			free(name);
+			inv->fname = fn;
+			inv->lineno = (int)ln;
+			inv->argc = (int)argc;
+			if (argc > 0) {
+				inv->argv = malloc(sizeof(char*) * argc);
+				fail2malloc(inv->argv, __LINE__);
+			}
+			if (last_inv == NULL) {
+				ap_inv_head = inv;
+			}
+			else {
+				last_inv->next = inv;
+			}
+			last_inv = inv;
+		}
+		for (k = 0; k < argc; ++k) {
+			char* arg;
+			if (state_get_str(in, &arg)) {
+				return __LINE__;
+			}
+			if (in->build) {
+				inv->argv[k] = arg;
+			}
+		}
+	}
+	if (in->p != in->end) {
+		return __LINE__;
+	}
+	return 0;
+}
+/**
+Checks a whole snapshot before putting any of it into ram.
+@param james_h_hash
+the hash of the james.h it has to go with
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int state_parse(const unsigned char* data, size_t size, struct hash64 james_h_hash) {
+	unsigned int version;
+	unsigned int order;
+	struct state_in in;
+	if (size < STATE_HEAD_LEN + STATE_HASH_LEN
+		|| memcmp(data, s_state_magic, sizeof s_state_magic) != 0) {
+		return __LINE__;
+	}
+	memcpy(&version, data + 8, sizeof version);
+	memcpy(&order, data + 12, sizeof order);
+	if (version != STATE_VERSION || order != STATE_BYTE_ORDER
+		|| !hash64_same(state_hash_from(data + 16), james_h_hash)
+		|| !hash64_same(state_hash_from(data + size - STATE_HASH_LEN),
+			fnv1a(s_fnv1a_init, data + STATE_HEAD_LEN,
+				(long)(size - STATE_HEAD_LEN - STATE_HASH_LEN)))) {
+		return __LINE__;
+	}
+	in.p = data + STATE_HEAD_LEN;
+	in.end = data + size - STATE_HASH_LEN;
+	in.build = 0;
+	if (state_read(&in) != 0) {
+		return __LINE__;
+	}
+	in.p = data + STATE_HEAD_LEN;
+	in.build = 1;
+	return state_read(&in);
+}
+#ifdef _POSIX_SOURCE
+#include <sys/mman.h>
+#endif
+#ifndef JAMES_NO_MAIN
+/*--what is checked, with --optimistic, to see whether james.h was
+changed by someone else since it was loaded--*/
+struct header_token {
+	unsigned long generation;
+	int exists;
+	long size;
+	long mtime;
+	long ino;
+	/*--as --journal appends to it without writing james.h--*/
+	long journal_size;
+};
+static void header_token_get(const char* james_h, struct header_token* t) {
+	char path[4096];
+	struct stat st;
+	memset(t, 0, sizeof *t);
+	t->generation = state_peek_generation(james_h);
+	if (stat(james_h, &st) == 0) {
+		t->exists = 1;
+		t->size = (long)st.st_size;
+		t->mtime = (long)st.st_mtime;
+		t->ino = (long)st.st_ino;
+	}
+	snprintf(path, sizeof path, "%s.journal", james_h);
+	t->journal_size = (stat(path, &st) == 0) ? (long)st.st_size : -1;
+}
+static int header_token_same(const struct header_token* a, const struct header_token* b) {
+	return a->generation == b->generation && a->exists == b->exists
+		&& a->size == b->size && a->mtime == b->mtime && a->ino == b->ino
+		&& a->journal_size == b->journal_size;
+}
+#endif
+/**
+Frees everything held in ram for james.h, so that it can be
+loaded again.
+*/
+static void james_state_clear(void) {
+	while (first_list != NULL) {
+		struct list* next_list = first_list->next_list;
+		struct list_item* y = first_list->head;
+		while (y != NULL) {
+			struct list_item* next = y->next;
+			free(y->value);
+			free(y);
+			y = next;
+		}
+		free(first_list->name);
+		free(first_list);
+		first_list = next_list;
+	}
+	while (alias_plus_head != NULL) {
+		struct alias_plus* next = alias_plus_head->next;
+		struct alias_positional* pos = alias_plus_head->head;
+		struct alias_plus_macroline* ml = alias_plus_head->macro_lines;
+		int i;
+		while (pos != NULL) {
+			struct alias_positional* next_pos = pos->next;
+			free(pos);
+			pos = next_pos;
+		}
+		for (; ml != NULL; ml = ml->next) {
+			free(ml->line);
+		}
+		alias_plus_free_macrolines(alias_plus_head->macro_lines);
+		if (alias_plus_head->alsoPlus != NULL) {
+			for (i = 0; i < alias_plus_head->alsoPlusNum; ++i) {
+				free(alias_plus_head->alsoPlus[i]);
+			}
+			free(alias_plus_head->alsoPlus);
+		}
+		free(alias_plus_head->define_output_name);
+		free(alias_plus_head->name);
+		free(alias_plus_head);
+		alias_plus_head = next;
+	}
+	free(alias_plus_buckets);
+	alias_plus_buckets = NULL;
+	ap_inv_free(ap_inv_head);
+	ap_inv_head = NULL;
+}
+/**
+Loads james.h.state into ram, if it goes with james.h as it is
+now and nothing is in ram yet.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int state_load(const char* james_h) {
+	char path[4096];
+	struct hash64 h;
+	int ret;
+	if (first_list != NULL || alias_plus_head != NULL || ap_inv_head != NULL) {
+		return __LINE__;
+	}
+	snprintf(path, sizeof path, "%s.state", james_h);
+	if (file_hash(james_h, &h) != 0) {
+		return __LINE__;
+	}
+#ifdef _POSIX_SOURCE
+	{
+		struct stat st;
+		void* data;
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			return __LINE__;
+		}
+		if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+			close(fd);
+			return __LINE__;
+		}
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			return __LINE__;
+		}
+		ret = state_parse((const unsigned char*)data, (size_t)st.st_size, h);
+		munmap(data, (size_t)st.st_size);
+	}
+#else
+	{
+		unsigned char* data;
+		long size;
+		FILE* f = fopen(path, "rb");
+		if (f == NULL) {
+			return __LINE__;
+		}
+		if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0
+			|| fseek(f, 0, SEEK_SET) != 0) {
+			fclose(f);
+			return __LINE__;
+		}
+		data = malloc((size_t)size);
+		fail2malloc(data, __LINE__);
+		if (fread(data, 1, (size_t)size, f) != (size_t)size) {
+			free(data);
+			fclose(f);
+			return __LINE__;
+		}
+		fclose(f);
+		ret = state_parse(data, (size_t)size, h);
+		free(data);
+	}
+#endif
+	return ret;
+}
+/**
+Loads into ram everything that a previous run wrote to james.h,
+it is fine if there is no james.h yet.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int load_james_h(const char* james_h) {
+	FILE* j;
+	/*--no need to parse the ram dump when there is a snapshot--*/
+	if (state_load(james_h) == 0) {
+		return 0;
+	}
+#ifdef _POSIX_SOURCE
+	{
+		/*--james.h is only ever replaced by a rename, never written
+		in place, so the mapping cannot change under the parse--*/
+		struct stat st;
+		void* data;
+		int subret;
+		int fd = open(james_h, O_RDONLY);
+		if (fd < 0) {
+			return 0;
+		}
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			return __LINE__;
+		}
+		if (st.st_size == 0) {
+			close(fd);
+			return 0;
+		}
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+			madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+			subret = parse_buf(NULL, (const char*)data, (long)st.st_size,
+				NULL, NULL);
+			munmap(data, (size_t)st.st_size);
+			return subret;
+		}
+		/*--a file system that cannot map it is read below--*/
+	}
+#endif
+	j = fopen(james_h,"r");
+	if(j != NULL) {
+		int subret;
+		old_parse(0,j);
+		subret = parse_src(NULL, j, NULL, NULL);
+		fclose(j);
+		return subret;
+	}
+	return 0;
+}
+/**
+Writes the fixed header part that every james.h starts with.
+*/
+static void james_h_start(FILE* j) {
+	char timbuf[TIMBUFSZ+1];
+	fwrite(header, 1, strlen(header), j);
+	gtimbuf(&timbuf[0]);
+	fprintf(j, "\n/*\nGenerated on %s\n*/\n\n", timbuf);
+}
+/**
+Starts james.h afresh with only the fixed header part in it, but
+in "james.h.tmp" next to it, see commit_james_h().
+@return
+the file handle for writing the rest, or NULL if it could not be
+written
+*/
+static FILE* create_james_h(const char* james_h) {
+	char tmp[TMP_PATH_LEN];
+	FILE* j;
+	snprintf(tmp, sizeof tmp, "%s%s", james_h, g_tmp_ext);
+	j = fopen(tmp, "w");
+	if (j == NULL) {
+		printf("error cannot open '%s' for writing\n", tmp);
+		return NULL;
+	}
+	james_h_start(j);
+	return j;
+}
+/**
+Hashes a james.h, except for its "Generated on" line, so that
+two made at different times with the same content hash the same.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int james_h_hash(const char* path, struct hash64* hash) {
+	char buf[4096];
+	int line_start = 1;
+	int skipping = 0;
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		return __LINE__;
+	}
+	*hash = s_fnv1a_init;
+	while (fgets(buf, sizeof buf, f) != NULL) {
+		size_t n = strlen(buf);
+		if (line_start && strncmp(buf, "Generated on ", 13) == 0) {
+			skipping = 1;
+		}
+		if (!skipping) {
+			*hash = fnv1a(*hash, (const unsigned char*)buf, (long)n);
+		}
+		line_start = (n > 0 && buf[n - 1] == '\n');
+		if (line_start) {
+			skipping = 0;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+/**
+Closes the james.h made by create_james_h() and moves it into
+place, but only if it differs from the one already there, so that
+its modified time only changes when its content does and make
+does not rebuild everything that includes it for nothing. Either
+way nobody ever sees it half written.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int commit_james_h(FILE* j, const char* james_h) {
+	int ret = close_james_h(j, james_h);
+	if (ret) {
+		return ret;
+	}
+	return move_james_h(james_h);
+}
+/**
+Closes the james.h made by create_james_h(), see commit_james_h().
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int close_james_h(FILE* j, const char* james_h) {
+	char tmp[TMP_PATH_LEN];
+	snprintf(tmp, sizeof tmp, "%s%s", james_h, g_tmp_ext);
+	if (fclose(j) != 0) {
+		remove(tmp);
+		printf("error cannot write '%s'\n", tmp);
+		return __LINE__;
+	}
+	return 0;
+}
+/**
+Moves the closed james.h made by create_james_h() into place, see
+commit_james_h().
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int move_james_h(const char* james_h) {
+	char tmp[TMP_PATH_LEN];
+	struct hash64 old_hash;
+	struct hash64 new_hash;
+	snprintf(tmp, sizeof tmp, "%s%s", james_h, g_tmp_ext);
+	if (james_h_hash(james_h, &old_hash) == 0
+		&& james_h_hash(tmp, &new_hash) == 0
+		&& hash64_same(old_hash, new_hash)) {
+		remove(tmp);
+		return 0;
+	}
+#ifndef _POSIX_SOURCE
+	remove(james_h);
+#endif
+	if (rename(tmp, james_h) != 0) {
+		remove(tmp);
+		printf("error cannot rename '%s' to '%s'\n", tmp, james_h);
+		return __LINE__;
+	}
+	return 0;
+}
+#ifndef JAMES_NO_MAIN
+/**
+Puts the james.h being made into place even though a source file
+had an error, so that the error can be seen in it, and releases
+the lock. With --optimistic it was loaded without the lock, so it
+only goes in place if nobody else wrote james.h since, otherwise
+theirs is kept.
+@param before
+what james.h was like when it was loaded, NULL when it has been
+locked all along
+*/
+static void commit_james_h_on_error(FILE* j, const char* james_h,
+	const struct header_token* before) {
+	struct header_token after;
+	if (before == NULL) {
+		commit_james_h(j, james_h);
+		unlock();
+		return;
+	}
+	if (close_james_h(j, james_h) != 0) {
+		return;
+	}
+	if (lock() != 0) {
+		return;
+	}
+	header_token_get(james_h, &after);
+	if (header_token_same(before, &after)) {
+		move_james_h(james_h);
+	}
+	else {
+		char tmp[TMP_PATH_LEN];
+		snprintf(tmp, sizeof tmp, "%s%s", james_h, g_tmp_ext);
+		remove(tmp);
+	}
+	unlock();
+}
+#endif
+/**
+Applies what one source file contributes to the ram, and then
+runs the alsos of the alias_plus invocations that it added.
+@param c
+what was recorded
+@param src_c
+the path of the source file, for messages
+@param j
+the james.h file handle (append mode)
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int contrib_apply_src(struct contrib* c, const char* src_c, FILE* j) {
+	struct ap_invocation* before;
+	int ret = c->ret;
+	if (c->cant_open) {
+		printf("error cannot open '%s' for reading\n",
+			src_c);
+	}
+	else if (ret == 0) {
+		before = ap_inv_tail();
+		contrib_apply(c, j);
+		ap_inv_proc_alsos_after(before);
+	}
+	else {
+		contrib_put_errors(c, j);
+	}
+	return ret;
+}
+
+/*--from here on down to lib/libjames.h, only for main()--*/
+#ifndef JAMES_NO_MAIN
+/*--with -MD the source files that contributed anything to james.h
+are written to a depfile for make or ninja, so they can skip
+running james when none of them changed--*/
+static const char* g_depfile = NULL;
+static char** g_deps = NULL;
+static int g_num_deps = 0;
+static int g_deps_alloced = 0;
+static void dep_add(const char* path) {
+	if (g_depfile == NULL) {
+		return;
+	}
+	if (g_num_deps == g_deps_alloced) {
+		char** newdeps;
+		g_deps_alloced += 64;
+		newdeps = realloc(g_deps, sizeof(char*) * g_deps_alloced);
+		fail2malloc(newdeps, __LINE__);
+		g_deps = newdeps;
+	}
+	g_deps[g_num_deps] = malloc(strlen(path) + 1);
+	fail2malloc(g_deps[g_num_deps], __LINE__);
+	memcpy(g_deps[g_num_deps], path, strlen(path) + 1);
+	++g_num_deps;
+}
+/**
+Adds path to the depfile unless there is no such file any more,
+for a source file that was deleted since it was written.
+*/
+static void dep_add_existing(const char* path) {
+	FILE* f = fopen(path, "r");
+	if (f != NULL) {
+		fclose(f);
+		dep_add(path);
+	}
+}
+/**
+Reads back the source files of the depfile from last time, for
+when james.h is added to rather than made afresh, as what they
+contributed is still in it.
+*/
+static void dep_load(const char* path) {
+	char word[4096];
+	int n = 0;
+	int seen_colon = 0;
+	int ch;
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		return;
+	}
+	while ((ch = fgetc(f)) != EOF) {
+		if (ch == '\\') {
+			ch = fgetc(f);
+			if (ch == '\n' || ch == '\r' || ch == EOF) {
+				ch = ' ';
+			}
+			else if (n < (int)sizeof word - 1) {
+				word[n++] = (char)ch;
+				continue;
+			}
+		}
+		if (!seen_colon) {
+			seen_colon = (ch == ':');
+			continue;
+		}
+		if (isspace(ch)) {
+			if (n > 0) {
+				word[n] = '\0';
+				dep_add_existing(word);
+				n = 0;
+			}
+			/*--the rest are the targets of dep_save() for make--*/
+			if (ch == '\n') {
+				break;
+			}
+		}
+		else if (n < (int)sizeof word - 1) {
+			word[n++] = (char)ch;
+		}
+	}
+	if (n > 0) {
+		word[n] = '\0';
+		dep_add_existing(word);
+	}
+	fclose(f);
+}
+static void dep_clear(void) {
+	int i;
+	for (i = 0; i < g_num_deps; ++i) {
+		free(g_deps[i]);
+	}
+	g_num_deps = 0;
+}
+static int dep_cmp(const void* a, const void* b) {
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+/**
+Writes path the way make reads it in a depfile.
+*/
+static void dep_put_path(FILE* f, const char* path) {
+	const char* p;
+	for (p = path; *p != '\0'; ++p) {
+		if (*p == ' ' || *p == '\\' || *p == '#') {
+			fputc('\\', f);
+		}
+		if (*p == '$') {
+			fputc('$', f);
+		}
+		fputc(*p, f);
+	}
+}
+/**
+Writes the depfile, james_h depending on each source file once,
+and each source file as a target of its own with nothing to do,
+like "-MP", so that make does not stop when one is deleted.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int dep_save(const char* james_h) {
+	char tmp[4096];
+	FILE* f;
+	int i;
+	snprintf(tmp, sizeof tmp, "%s.tmp", g_depfile);
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		printf("error cannot open '%s' for writing\n", tmp);
+		return __LINE__;
+	}
+	qsort(g_deps, g_num_deps, sizeof(char*), dep_cmp);
+	fputs(james_h, f);
+	fputc(':', f);
+	for (i = 0; i < g_num_deps; ++i) {
+		if (i > 0 && strcmp(g_deps[i], g_deps[i - 1]) == 0) {
+			continue;
+		}
+		fputs(" \\\n ", f);
+		dep_put_path(f, g_deps[i]);
+	}
+	fputc('\n', f);
+	for (i = 0; i < g_num_deps; ++i) {
+		if (i > 0 && strcmp(g_deps[i], g_deps[i - 1]) == 0) {
+			continue;
+		}
+		fputc('\n', f);
+		dep_put_path(f, g_deps[i]);
+		fputs(":\n", f);
+	}
+	if (fclose(f) != 0) {
+		remove(tmp);
+		printf("error cannot write '%s'\n", tmp);
+		return __LINE__;
+	}
+#ifndef _POSIX_SOURCE
+	remove(g_depfile);
+#endif
+	if (rename(tmp, g_depfile) != 0) {
+		remove(tmp);
+		printf("error cannot rename '%s' to '%s'\n", tmp, g_depfile);
+		return __LINE__;
+	}
+	return 0;
+}
+/**
+Parses source file i of g_srcs, unless it was already parsed on
+the worker threads or is in the --cache, and applies it.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int run_src(int i, FILE* j) {
+	const char* src_c = g_srcs[i];
+	struct contrib one;
+	struct contrib* c = &one;
+	int ret;
+	if (g_contribs != NULL) {
+		c = &g_contribs[i];
+	}
+	else {
+		contrib_scan(c, src_c);
+	}
+	ret = contrib_apply_src(c, src_c, j);
+	if (ret == 0 && c->contributed) {
+		dep_add(src_c);
+	}
+	if (ret == 0 && g_cache_path != NULL) {
+		cache_store(src_c, c);
+	}
+	if (!g_keep_contribs) {
+		contrib_free(c);
+	}
+	if (ret != 0) {
+		if (j != NULL) {
+			fprintf(j,"\n/* (while processing file %s) */\n", src_c);
+		}
+		printf( "\n/* (while processing file %s) */\n", src_c);
+	}
+	return ret;
+}
+
+/*--with --spool each source file gets a fragment file of its own
+in the spool folder saying what it contributes, written with no
+lock at all so any number can run at once, and "--merge folder"
+then applies all of them to james.h in one go. Fragments are
+in the same format as the --cache file--*/
+static const char* s_frag_ext = ".jsf";
+/**
+Writes the fragment for one source file, next to it first and
+then moved into place, so --merge never sees it half written.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int frag_write(const char* dir, const char* src_c, const struct contrib* c) {
+	char fname[sizeof g_je_filename];
+	char path[4096];
+	char tmp[4096 + 32];
+	FILE* f;
+	struct hash64 h = fnv1a(s_fnv1a_init,
+		(const unsigned char*)src_c, (long)strlen(src_c));
+	src_basename(fname, src_c);
+	snprintf(path, sizeof path, "%s/%s-" HASH64_FMT "%s", dir, fname,
+		h.hi, h.lo, s_frag_ext);
+#ifdef _POSIX_SOURCE
+	snprintf(tmp, sizeof tmp, "%s.%ld.tmp", path, (long)getpid());
+#else
+	snprintf(tmp, sizeof tmp, "%s.tmp", path);
+#endif
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		printf("error cannot open '%s' for writing\n", tmp);
+		return __LINE__;
+	}
+	fprintf(f, "%s\nH -\n", s_cache_magic);
+	cache_put_entry(f, src_c, 1, c);
+	if (fclose(f) != 0) {
+		remove(tmp);
+		printf("error cannot write '%s'\n", tmp);
+		return __LINE__;
+	}
+#ifndef _POSIX_SOURCE
+	remove(path);
+#endif
+	if (rename(tmp, path) != 0) {
+		remove(tmp);
+		printf("error cannot rename '%s' to '%s'\n", tmp, path);
+		return __LINE__;
+	}
+	return 0;
+}
+/**
+Parses each of g_srcs and writes its fragment into dir, with no
+lock and no james.h.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int spool_main(const char* dir) {
+	int i;
+	int ret = 0;
+#ifdef _POSIX_SOURCE
+	mkdir(dir, 0777);
+#elif defined(_MSC_VER)
+	_mkdir(dir);
+#endif
+	contrib_scan_all();
+	for (i = 0; i < g_num_srcs; ++i) {
+		struct contrib one;
+		struct contrib* c = &one;
+		int subret;
+		if (g_contribs != NULL) {
+			c = &g_contribs[i];
+		}
+		else {
+			contrib_scan(c, g_srcs[i]);
+		}
+		if (c->cant_open) {
+			printf("error cannot open '%s' for reading\n", g_srcs[i]);
+			subret = __LINE__;
+		}
+		else if (c->ret != 0) {
+			contrib_put_errors(c, NULL);
+			printf( "\n/* (while processing file %s) */\n", g_srcs[i]);
+			subret = c->ret;
+		}
+		else {
+			subret = frag_write(dir, g_srcs[i], c);
+		}
+		contrib_free(c);
+		if (subret && !ret) {
+			ret = subret;
+		}
+	}
+	return ret;
+}
+struct frag {
+	char* src;
+	struct contrib c;
+};
+static int frag_cmp(const void* a, const void* b) {
+	return strcmp(((const struct frag*)a)->src, ((const struct frag*)b)->src);
+}
+/**
+Reads one fragment written by frag_write().
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int frag_read(const char* path, struct frag* fr) {
+	char linebuf[8192];
+	char fname[sizeof g_je_filename];
+	int live;
+	int pathat;
+	int n;
+	struct src_stamp stamp;
+	struct hash64 hash;
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		printf("error cannot open '%s' for reading\n", path);
+		return __LINE__;
+	}
+	if (fgets(linebuf, sizeof linebuf, f) == NULL
+		|| strncmp(linebuf, s_cache_magic, strlen(s_cache_magic)) != 0
+		|| fgets(linebuf, sizeof linebuf, f) == NULL
+		|| fgets(linebuf, sizeof linebuf, f) == NULL) {
+		fclose(f);
+		printf("error '%s' is not a james fragment\n", path);
+		return __LINE__;
+	}
+	n = strlen(linebuf);
+	if (n > 0 && linebuf[n - 1] == '\n') {
+		linebuf[n - 1] = '\0';
+	}
+	/*--the fingerprint is read and dropped, the fragment is only
+	ever merged--*/
+	if (cache_get_stamp(linebuf, &live, &stamp, &hash, &pathat) != 0) {
+		fclose(f);
+		printf("error '%s' is not a james fragment\n", path);
+		return __LINE__;
+	}
+	fr->src = malloc(strlen(linebuf + pathat) + 1);
+	fail2malloc(fr->src, __LINE__);
+	memcpy(fr->src, linebuf + pathat, strlen(linebuf + pathat) + 1);
+	src_basename(fname, fr->src);
+	contrib_init(&fr->c, fname);
+	if (cache_get_entry(f, &fr->c) != 0) {
+		fclose(f);
+		contrib_free(&fr->c);
+		free(fr->src);
+		printf("error '%s' is not a james fragment\n", path);
+		return __LINE__;
+	}
+	fclose(f);
+	return 0;
+}
+#ifdef _POSIX_SOURCE
+#include <dirent.h>
+#endif
+/**
+Reads every fragment in dir and makes them g_srcs and g_contribs,
+in the order of their source file paths, so it is the same no
+matter what order they were spooled in.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int merge_load(const char* dir) {
+	struct frag* frags = NULL;
+	int num_frags = 0;
+	int frags_alloced = 0;
+	int i;
+	int ret = 0;
+	char path[4096];
+	const char* name;
+#ifdef _POSIX_SOURCE
+	struct dirent* de;
+	DIR* d = opendir(dir);
+	if (d == NULL) {
+		printf("error cannot open folder '%s'\n", dir);
+		return __LINE__;
+	}
+	while (ret == 0 && (de = readdir(d)) != NULL) {
+		name = de->d_name;
+#elif defined(_MSC_VER)
+	WIN32_FIND_DATAA fd;
+	HANDLE d;
+	snprintf(path, sizeof path, "%s\\*%s", dir, s_frag_ext);
+	d = FindFirstFileA(path, &fd);
+	if (d == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+	do {
+		name = fd.cFileName;
+#else
+	puts("error --merge needs POSIX or Windows");
+	return __LINE__;
+	{
+		name = NULL;
+#endif
+		if (strlen(name) > strlen(s_frag_ext)
+			&& strcmp(name + strlen(name) - strlen(s_frag_ext), s_frag_ext) == 0) {
+			if (num_frags == frags_alloced) {
+				struct frag* newfrags;
+				frags_alloced += 64;
+				newfrags = realloc(frags, sizeof(struct frag) * frags_alloced);
+				fail2malloc(newfrags, __LINE__);
+				frags = newfrags;
+			}
+			snprintf(path, sizeof path, "%s/%s", dir, name);
+			ret = frag_read(path, &frags[num_frags]);
+			if (ret == 0) {
+				++num_frags;
+			}
+		}
+#ifdef _POSIX_SOURCE
+	}
+	closedir(d);
+#elif defined(_MSC_VER)
+	} while (ret == 0 && FindNextFileA(d, &fd));
+	FindClose(d);
+#else
+	}
+#endif
+	if (num_frags > 0) {
+		qsort(frags, num_frags, sizeof(struct frag), frag_cmp);
+		g_contribs = malloc(sizeof(struct contrib) * num_frags);
+		fail2malloc(g_contribs, __LINE__);
+	}
+	for (i = 0; i < num_frags; ++i) {
+		if (ret == 0) {
+			add_src(frags[i].src);
+			g_contribs[i] = frags[i].c;
+		}
+		else {
+			contrib_free(&frags[i].c);
+		}
+		free(frags[i].src);
+	}
+	free(frags);
+	return ret;
+}
+
+/*--with --journal a run only appends what its source files
+contribute to "james.h.journal", rather than writing james.h, each
+record with its length and hash so that one left half written is
+noticed, and cut off by the next run that appends. Any run that does write james.h applies the journal on
+top of it first and then removes it, so "--compact" with no source
+files just does that--*/
+static long g_compact_at = 0;
+static void journal_path(char* out, int outsz, const char* james_h) {
+	snprintf(out, outsz, "%s.journal", james_h);
+}
+/**
+Cuts the journal back to its last whole record, as what is appended
+after a record left half written by a run that died would never be
+replayed, the lock has to be held. Only the last record can be half
+written, so only that one is hashed.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int journal_trim(const char* path) {
+	char linebuf[8192];
+	FILE* f;
+	long size;
+	long whole = 0;
+	long last_at = -1;
+	long last_len = 0;
+	long before_last = 0;
+	struct hash64 last_sum;
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		return 0;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	last_sum = s_fnv1a_init;
+	while (fgets(linebuf, sizeof linebuf, f) != NULL) {
+		long len;
+		struct hash64 sum;
+		long at = ftell(f);
+		if (sscanf(linebuf, "J %ld " HASH64_SCAN, &len, &sum.hi, &sum.lo) != 3
+			|| len <= 0 || len > size - at) {
+			break;
+		}
+		before_last = whole;
+		whole = at + len;
+		last_at = at;
+		last_len = len;
+		last_sum = sum;
+		fseek(f, whole, SEEK_SET);
+	}
+	if (last_at >= 0) {
+		char* buf = malloc(last_len);
+		fail2malloc(buf, __LINE__);
+		fseek(f, last_at, SEEK_SET);
+		if ((long)fread(buf, 1, last_len, f) != last_len
+			|| !hash64_same(last_sum,
+				fnv1a(s_fnv1a_init, (const unsigned char*)buf, last_len))) {
+			whole = before_last;
+		}
+		free(buf);
+	}
+	if (whole == size) {
+		fclose(f);
+		return 0;
+	}
+	printf("warning cutting off the half written end of '%s'\n", path);
+#ifdef _POSIX_SOURCE
+	fclose(f);
+	if (truncate(path, (off_t)whole) != 0) {
+		printf("error cannot cut off the end of '%s'\n", path);
+		return __LINE__;
+	}
+#else
+	{
+		/*--no truncate(), so the whole records are written again--*/
+		char* buf = malloc(whole > 0 ? whole : 1);
+		fail2malloc(buf, __LINE__);
+		rewind(f);
+		if ((long)fread(buf, 1, whole, f) != whole) {
+			fclose(f);
+			free(buf);
+			printf("error cannot read '%s'\n", path);
+			return __LINE__;
+		}
+		fclose(f);
+		f = fopen(path, "wb");
+		if (f == NULL || (long)fwrite(buf, 1, whole, f) != whole) {
+			if (f != NULL) {
+				fclose(f);
+			}
+			free(buf);
+			printf("error cannot write '%s'\n", path);
+			return __LINE__;
+		}
+		free(buf);
+		if (fclose(f) != 0) {
+			printf("error cannot write '%s'\n", path);
+			return __LINE__;
+		}
+	}
+#endif
+	return 0;
+}
+/**
+Appends a record for each of g_srcs to the journal, the lock has
+to be held.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int journal_append(const char* james_h, long* journal_size) {
+	char path[4096];
+	FILE* f;
+	FILE* t;
+	int i;
+	int ret = 0;
+	journal_path(path, sizeof path, james_h);
+	ret = journal_trim(path);
+	if (ret) {
+		return ret;
+	}
+	f = fopen(path, "ab");
+	if (f == NULL) {
+		printf("error cannot open '%s' for appending\n", path);
+		return __LINE__;
+	}
+	for (i = 0; i < g_num_srcs && ret == 0; ++i) {
+		struct contrib* c = &g_contribs[i];
+		char* buf;
+		long len;
+		if (c->cant_open) {
+			printf("error cannot open '%s' for reading\n", g_srcs[i]);
+			ret = __LINE__;
+			break;
+		}
+		if (c->ret != 0) {
+			contrib_put_errors(c, NULL);
+			printf( "\n/* (while processing file %s) */\n", g_srcs[i]);
+			ret = c->ret;
+			break;
+		}
+		/*--the record has to be whole to know its length and hash--*/
+		t = tmpfile();
+		if (t == NULL) {
+			puts("error cannot make a temporary file");
+			ret = __LINE__;
+			break;
+		}
+		cache_put_entry(t, g_srcs[i], 1, c);
+		len = ftell(t);
+		buf = malloc(len > 0 ? len : 1);
+		fail2malloc(buf, __LINE__);
+		rewind(t);
+		if (len < 0 || fread(buf, 1, len, t) != (size_t)len) {
+			puts("error cannot read back a temporary file");
+			ret = __LINE__;
+		}
+		else {
+			struct hash64 sum = fnv1a(s_fnv1a_init, (const unsigned char*)buf, len);
+			fprintf(f, "J %ld " HASH64_FMT "\n", len, sum.hi, sum.lo);
+			fwrite(buf, 1, len, f);
+		}
+		free(buf);
+		fclose(t);
+	}
+	*journal_size = ftell(f);
+	if (fclose(f) != 0 && ret == 0) {
+		printf("error cannot write '%s'\n", path);
+		ret = __LINE__;
+	}
+	return ret;
+}
+/**
+Applies each whole record in the journal, in the order they were
+appended, as if their source files were given. With --cache they
+also replace what the cache holds for those source files, and if
+the cache says what james.h is made of they are only applied from
+there.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int journal_replay(const char* james_h, FILE* j, int from_cache) {
+	char path[4096];
+	char linebuf[8192];
+	FILE* f;
+	int ret = 0;
+	journal_path(path, sizeof path, james_h);
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		return 0;
+	}
+	while (ret == 0 && fgets(linebuf, sizeof linebuf, f) != NULL) {
+		long len;
+		struct hash64 sum;
+		long at = ftell(f);
+		char* buf;
+		int live;
+		struct src_stamp stamp;
+		struct hash64 hash;
+		int pathat;
+		char fname[sizeof g_je_filename];
+		struct contrib c;
+		int n;
+		if (sscanf(linebuf, "J %ld " HASH64_SCAN, &len, &sum.hi, &sum.lo) != 3
+			|| len <= 0) {
+			break;
+		}
+		buf = malloc(len);
+		fail2malloc(buf, __LINE__);
+		n = (int)fread(buf, 1, len, f);
+		if (n != len || !hash64_same(sum,
+				fnv1a(s_fnv1a_init, (const unsigned char*)buf, len))) {
+			/*--only the last one can be, from a run that died--*/
+			free(buf);
+			printf("warning ignoring the half written end of '%s'\n", path);
+			break;
+		}
+		free(buf);
+		fseek(f, at, SEEK_SET);
+		if (fgets(linebuf, sizeof linebuf, f) == NULL) {
+			break;
+		}
+		n = strlen(linebuf);
+		if (n > 0 && linebuf[n - 1] == '\n') {
+			linebuf[n - 1] = '\0';
+		}
+		if (cache_get_stamp(linebuf, &live, &stamp, &hash, &pathat) != 0) {
+			break;
+		}
+		src_basename(fname, linebuf + pathat);
+		contrib_init(&c, fname);
+		c.stamp = stamp;
+		c.hash = hash;
+		{
+			char src_c[4096];
+			snprintf(src_c, sizeof src_c, "%s", linebuf + pathat);
+			if (cache_get_entry(f, &c) != 0
+				|| ftell(f) != at + len) {
+				contrib_free(&c);
+				printf("warning ignoring the rest of '%s'\n", path);
+				break;
+			}
+			if (!from_cache) {
+				ret = contrib_apply_src(&c, src_c, j);
+				if (ret == 0 && c.contributed) {
+					dep_add(src_c);
+				}
+			}
+			if (ret == 0 && g_cache_path != NULL) {
+				cache_store(src_c, &c);
+			}
+		}
+		contrib_free(&c);
+	}
+	fclose(f);
+	return ret;
+}
+
+#ifdef _POSIX_SOURCE
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/select.h>
+/*--what one source file contributed to a session, kept so that
+a SCAN of it again replaces that rather than adds to it--*/
+struct daemon_src {
+	char* path;
+	struct contrib c;
+	struct daemon_src* next;
+};
+/*--one james.h held in ram by the daemon--*/
+struct daemon_session {
+	char* james_h;
+	struct james_state st;
+	int dirty;
+	/*--james.h as it was when first loaded, NULL if there was none,
+	which with srcs is what the session is made again from--*/
+	char* base;
+	long base_len;
+	/*--in the order they were first sent--*/
+	struct daemon_src* srcs;
+	struct daemon_src* srcs_tail;
+	struct daemon_session* next;
+};
+static struct daemon_session* g_sessions = NULL;
+/*--seconds without requests after which the daemon writes out
+every james.h that changed--*/
+static int g_idle_flush = 2;
+/*--seconds a client may keep the daemon waiting for its next
+request line, before it is hung up on so others get their turn--*/
+static int g_client_timeout = 5;
+
+/**
+Makes the path absolute, as the daemon does not run in the same
+folder as its clients do.
+@param out
+where to write the absolute path
+@param outsz
+the size of out, longer paths are cut short
+*/
+static void abs_path(char* out, int outsz, const char* path) {
+	if (path[0] == '/') {
+		snprintf(out, outsz, "%s", path);
+	}
+	else {
+		char cwd[4096];
+		if (getcwd(cwd, sizeof cwd) == NULL) {
+			cwd[0] = '\0';
+		}
+		snprintf(out, outsz, "%s/%s", cwd, path);
+	}
+}
+/**
+Finds the session for a james.h, loading it from disk the first
+time, and swaps its state into ram.
+*/
+static struct daemon_session* daemon_session_use(const char* james_h, int* ret) {
+	struct daemon_session* x = g_sessions;
+	*ret = 0;
+	while (x != NULL) {
+		if (strcmp(x->james_h, james_h) == 0) {
+			james_state_load(&x->st);
+			return x;
+		}
+		x = x->next;
+	}
+	x = malloc(sizeof(struct daemon_session));
+	fail2malloc(x, __LINE__);
+	x->james_h = malloc(strlen(james_h) + 1);
+	fail2malloc(x->james_h, __LINE__);
+	memcpy(x->james_h, james_h, strlen(james_h) + 1);
+	x->dirty = 0;
+	x->base = NULL;
+	x->base_len = 0;
+	x->srcs = NULL;
+	x->srcs_tail = NULL;
+	x->next = g_sessions;
+	g_sessions = x;
+	memset(&x->st, 0, sizeof x->st);
+	james_state_load(&x->st);
+	*ret = lock_set_target(james_h);
+	if (*ret == 0) {
+		*ret = lock();
+	}
+	if (*ret == 0) {
+		if (src_read_all(james_h, &x->base, &x->base_len) != 0) {
+			x->base = NULL;
+			x->base_len = 0;
+		}
+		*ret = load_james_h(james_h);
+		unlock();
+	}
+	james_state_save(&x->st);
+	return x;
+}
+/**
+Whether two recordings of a source file would do the same.
+*/
+static int contrib_same(const struct contrib* a, const struct contrib* b) {
+	const struct contrib_rec* x = a->head;
+	const struct contrib_rec* y = b->head;
+	if (a->ret != b->ret || a->cant_open != b->cant_open) {
+		return 0;
+	}
+	while (x != NULL && y != NULL) {
+		if (x->kind != y->kind || x->hash != y->hash
+			|| x->lineno != y->lineno || x->test_from != y->test_from
+			|| (x->text == NULL) != (y->text == NULL)
+			|| (x->text != NULL && strcmp(x->text, y->text) != 0)) {
+			return 0;
+		}
+		x = x->next;
+		y = y->next;
+	}
+	return x == NULL && y == NULL;
+}
+/**
+Applies what a source file contributes now to the session, which
+must be swapped in. The first time it is added to what is there,
+after that the session is made again, from james.h as it was first
+loaded and every source file in the order they were first sent,
+so that what the source file no longer has is gone.
+@param c
+what the source file contributes, taken over
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int daemon_session_scan(struct daemon_session* x,
+	const char* src_c, struct contrib* c) {
+	struct daemon_src* y;
+	int ret = 0;
+	for (y = x->srcs; y != NULL; y = y->next) {
+		if (strcmp(y->path, src_c) == 0) {
+			break;
+		}
+	}
+	if (y == NULL) {
+		y = malloc(sizeof(struct daemon_src));
+		fail2malloc(y, __LINE__);
+		y->path = malloc(strlen(src_c) + 1);
+		fail2malloc(y->path, __LINE__);
+		memcpy(y->path, src_c, strlen(src_c) + 1);
+		y->c = *c;
+		y->next = NULL;
+		if (x->srcs_tail == NULL) {
+			x->srcs = y;
+		}
+		else {
+			x->srcs_tail->next = y;
+		}
+		x->srcs_tail = y;
+		x->dirty = 1;
+		return contrib_apply_src(&y->c, src_c, NULL);
+	}
+	if (contrib_same(&y->c, c)) {
+		/*--unchanged, so is the session--*/
+		contrib_free(c);
+		return y->c.ret;
+	}
+	contrib_free(&y->c);
+	y->c = *c;
+	james_state_clear();
+	if (x->base != NULL) {
+		ret = parse_buf(NULL, x->base, x->base_len, NULL, NULL);
+	}
+	for (y = x->srcs; y != NULL; y = y->next) {
+		int subret = contrib_apply_src(&y->c, y->path, NULL);
+		if (subret && !ret) {
+			ret = subret;
+		}
+	}
+	x->dirty = 1;
+	return ret;
+}
+/**
+Forgets the session, with nothing written.
+*/
+static void daemon_session_free(struct daemon_session* x) {
+	/*--swapped in only to be given back--*/
+	james_state_load(&x->st);
+	james_state_clear();
+	while (x->srcs != NULL) {
+		struct daemon_src* y = x->srcs;
+		x->srcs = y->next;
+		contrib_free(&y->c);
+		free(y->path);
+		free(y);
+	}
+	free(x->base);
+	free(x->james_h);
+	free(x);
+}
+/**
+Writes the james.h of the session if anything changed since.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int daemon_session_flush(struct daemon_session* x) {
+	FILE* j;
+	int subret;
+	if (!x->dirty) {
+		return 0;
+	}
+	james_state_load(&x->st);
+	subret = lock_set_target(x->james_h);
+	if (subret == 0) {
+		subret = lock();
+	}
+	if (subret) {
+		return subret;
+	}
+	shard_set_base(x->james_h);
+	j = create_james_h(x->james_h);
+	if (j == NULL) {
+		unlock();
+		return __LINE__;
+	}
+	finish_james_h(j);
+	subret = commit_james_h(j, x->james_h);
+	if (subret == 0) {
+		state_save(x->james_h);
+	}
+	unlock();
+	james_state_save(&x->st);
+	if (subret) {
+		return subret;
+	}
+	x->dirty = 0;
+	return 0;
+}
+static int daemon_flush_all(void) {
+	struct daemon_session* x;
+	int ret = 0;
+	for (x = g_sessions; x != NULL; x = x->next) {
+		int subret = daemon_session_flush(x);
+		if (subret && !ret) {
+			ret = subret;
+		}
+	}
+	return ret;
+}
+/**
+Carries out one request line from a client, they are
+"SCAN james.h<tab>source.c", "FLUSH james.h" or "FLUSH" for all,
+"RESET james.h" to forget it without writing, and "STOP".
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int daemon_request(char* req, int* stop) {
+	char* arg = req;
+	int ret = 0;
+	while (*arg != '\0' && *arg != ' ') {
+		++arg;
+	}
+	if (*arg == ' ') {
+		*arg = '\0';
+		++arg;
+	}
+	if (strcmp(req, "SCAN") == 0) {
+		char* src_c = strchr(arg, '\t');
+		struct daemon_session* x;
+		struct contrib c;
+		if (src_c == NULL) {
+			return __LINE__;
+		}
+		*src_c = '\0';
+		++src_c;
+		/*--parse before swapping in, it needs nothing in ram--*/
+		contrib_scan(&c, src_c);
+		x = daemon_session_use(arg, &ret);
+		if (ret == 0) {
+			ret = daemon_session_scan(x, src_c, &c);
+		}
+		else {
+			contrib_free(&c);
+		}
+		james_state_save(&x->st);
+	}
+	else if (strcmp(req, "FLUSH") == 0) {
+		if (arg[0] == '\0') {
+			ret = daemon_flush_all();
+		}
+		else {
+			struct daemon_session* x = daemon_session_use(arg, &ret);
+			if (ret == 0) {
+				ret = daemon_session_flush(x);
+			}
+		}
+	}
+	else if (strcmp(req, "RESET") == 0) {
+		struct daemon_session** px = &g_sessions;
+		while (*px != NULL) {
+			if (strcmp((*px)->james_h, arg) == 0) {
+				struct daemon_session* x = *px;
+				*px = x->next;
+				daemon_session_free(x);
+				break;
+			}
+			px = &(*px)->next;
+		}
+	}
+	else if (strcmp(req, "STOP") == 0) {
+		ret = daemon_flush_all();
+		*stop = 1;
+	}
+	else {
+		printf("error unknown daemon request '%s'\n", req);
+		ret = __LINE__;
+	}
+	return ret;
+}
+/**
+Keeps everything in ram between runs, serving requests from
+--client over a unix domain socket, until told to STOP. A client is
+served until it hangs up, or keeps it waiting g_client_timeout for
+a request, one at a time as the state in ram is all swapped in for
+the one request.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int daemon_main(const char* sockpath) {
+	struct sockaddr_un addr;
+	int lfd;
+	int stop = 0;
+	int idle = 0;
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (strlen(sockpath) + 1 > sizeof addr.sun_path) {
+		printf("error socket path '%s' is too long\n", sockpath);
+		return __LINE__;
+	}
+	memcpy(addr.sun_path, sockpath, strlen(sockpath) + 1);
+	signal(SIGPIPE, SIG_IGN);
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		printf("error cannot create socket\n");
+		return __LINE__;
+	}
+	unlink(sockpath);
+	if (bind(lfd, (struct sockaddr*)&addr, sizeof addr) != 0
+		|| listen(lfd, 64) != 0) {
+		printf("error cannot listen on '%s'\n", sockpath);
+		close(lfd);
+		return __LINE__;
+	}
+	while (!stop) {
+		fd_set rfds;
+		struct timeval tv;
+		int cfd;
+		FILE* in;
+		FILE* out;
+		char req[8192 + 2];
+		FD_ZERO(&rfds);
+		FD_SET(lfd, &rfds);
+		tv.tv_sec = g_idle_flush;
+		tv.tv_usec = 0;
+		if (select(lfd + 1, &rfds, NULL, NULL, idle ? NULL : &tv) == 0) {
+			/*--nothing for a while, so write out what changed--*/
+			daemon_flush_all();
+			idle = 1;
+			continue;
+		}
+		idle = 0;
+		cfd = accept(lfd, NULL, NULL);
+		if (cfd < 0) {
+			continue;
+		}
+		/*--a client that stops sending, or stops reading its answers,
+		must not keep everyone else waiting--*/
+		tv.tv_sec = g_client_timeout;
+		tv.tv_usec = 0;
+		setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+		setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+		in = fdopen(dup(cfd), "r");
+		out = fdopen(cfd, "w");
+		if (in == NULL || out == NULL) {
+			if (in != NULL) {
+				fclose(in);
+			}
+			close(cfd);
+			continue;
+		}
+		while (!stop && fgets(req, sizeof req, in) != NULL) {
+			int n = strlen(req);
+			while (n > 0 && (req[n - 1] == '\n' || req[n - 1] == '\r')) {
+				req[--n] = '\0';
+			}
+			fprintf(out, "%d\n", daemon_request(req, &stop));
+			fflush(out);
+		}
+		fclose(in);
+		fclose(out);
+	}
+	close(lfd);
+	unlink(sockpath);
+	return 0;
+}
+/**
+Sends the requests to a running --daemon and waits for all of
+the answers.
+@return
+the first answer that was not 0, or 0
+*/
+static int client_main(const char* sockpath, const char* james_h,
+	int flush, int reset, int stop) {
+	struct sockaddr_un addr;
+	int fd;
+	FILE* in;
+	FILE* out;
+	char abs_h[4096];
+	char abs_s[4096];
+	char answer[64];
+	int sent = 0;
+	int ret = 0;
+	int i;
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (strlen(sockpath) + 1 > sizeof addr.sun_path) {
+		printf("error socket path '%s' is too long\n", sockpath);
+		return __LINE__;
+	}
+	memcpy(addr.sun_path, sockpath, strlen(sockpath) + 1);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof addr) != 0) {
+		printf("error cannot connect to daemon at '%s'\n", sockpath);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return __LINE__;
+	}
+	in = fdopen(dup(fd), "r");
+	out = fdopen(fd, "w");
+	if (in == NULL || out == NULL) {
+		printf("error cannot talk to daemon at '%s'\n", sockpath);
+		return __LINE__;
+	}
+	if (james_h != NULL) {
+		abs_path(abs_h, sizeof abs_h, james_h);
+		if (reset) {
+			fprintf(out, "RESET %s\n", abs_h);
+			++sent;
+		}
+		for (i = 0; i < g_num_srcs; ++i) {
+			abs_path(abs_s, sizeof abs_s, g_srcs[i]);
+			fprintf(out, "SCAN %s\t%s\n", abs_h, abs_s);
+			++sent;
+		}
+		if (flush) {
+			fprintf(out, "FLUSH %s\n", abs_h);
+			++sent;
+		}
+	}
+	else if (flush) {
+		fputs("FLUSH\n", out);
+		++sent;
+	}
+	if (stop) {
+		fputs("STOP\n", out);
+		++sent;
+	}
+	fflush(out);
+	for (i = 0; i < sent; ++i) {
+		int subret;
+		if (fgets(answer, sizeof answer, in) == NULL) {
+			printf("error daemon at '%s' went away\n", sockpath);
+			ret = __LINE__;
+			break;
+		}
+		subret = strtol(answer, NULL, 10);
+		if (subret && !ret) {
+			ret = subret;
+		}
+	}
+	fclose(in);
+	fclose(out);
+	return ret;
+}
+#endif
+
+/*--"--watch" needs inotify, and the POSIX headers that a strict
+"-std=c99" leaves out--*/
+#if defined(__linux__) && defined(_POSIX_SOURCE)
+#define JAMES_WATCH
+#endif
+#ifdef JAMES_WATCH
+#include <sys/inotify.h>
+/*--with --watch the source files in the watched folders are held
+parsed in ram, what each one contributes kept on its own, so when
+one changes only it is parsed again, and james.h is made afresh
+from all of them in the order of their paths--*/
+struct watch_src {
+	char* path;
+	struct contrib c;
+};
+static struct watch_src* g_watch_srcs = NULL;
+static int g_num_watch_srcs = 0;
+static int g_watch_srcs_alloced = 0;
+/*--the folder of each inotify watch descriptor, and whether it is
+the one james.h or its shards are written to--*/
+struct watch_dir {
+	char* path;
+	int is_own;
+	int is_shard;
+};
+static struct watch_dir* g_watch_dirs = NULL;
+static int g_watch_dirs_alloced = 0;
+/*--paths that had events since james.h was last made--*/
+static char** g_watch_pending = NULL;
+static int g_num_watch_pending = 0;
+static int g_watch_pending_alloced = 0;
+/*--milliseconds with no events before james.h is made again, so
+that saving many files at once makes it only once--*/
+static int g_watch_debounce = 100;
+static int g_watch_fd = -1;
+static char g_watch_own_dir[PATH_MAX];
+static const char* g_watch_own_name = "";
+static char g_watch_shard_dir[PATH_MAX];
+static volatile sig_atomic_t g_watch_stop = 0;
+
+static void watch_on_signal(int sig) {
+	(void)sig;
+	g_watch_stop = 1;
+}
+static void watch_pending_add(const char* path) {
+	int i;
+	for (i = 0; i < g_num_watch_pending; ++i) {
+		if (strcmp(g_watch_pending[i], path) == 0) {
+			return;
+		}
+	}
+	if (g_num_watch_pending == g_watch_pending_alloced) {
+		char** newpending;
+		g_watch_pending_alloced += 64;
+		newpending = realloc(g_watch_pending, sizeof(char*) * g_watch_pending_alloced);
+		fail2malloc(newpending, __LINE__);
+		g_watch_pending = newpending;
+	}
+	g_watch_pending[g_num_watch_pending] = malloc(strlen(path) + 1);
+	fail2malloc(g_watch_pending[g_num_watch_pending], __LINE__);
+	memcpy(g_watch_pending[g_num_watch_pending], path, strlen(path) + 1);
+	++g_num_watch_pending;
+}
+/**
+Makes every source file held from under the folder dir pending,
+for when the folder was moved away or deleted.
+*/
+static void watch_pending_under(const char* dir) {
+	int n = strlen(dir);
+	int i;
+	for (i = 0; i < g_num_watch_srcs; ++i) {
+		if (strncmp(g_watch_srcs[i].path, dir, n) == 0
+			&& g_watch_srcs[i].path[n] == '/') {
+			watch_pending_add(g_watch_srcs[i].path);
+		}
+	}
+}
+/**
+Finds path among the source files held, which are in order.
+@param at
+where it is, or where it would go
+@return 1 if it is held, otherwise 0
+*/
+static int watch_find(const char* path, int* at) {
+	int lo = 0;
+	int hi = g_num_watch_srcs;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int cmp = strcmp(g_watch_srcs[mid].path, path);
+		if (cmp == 0) {
+			*at = mid;
+			return 1;
+		}
+		if (cmp < 0) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	*at = lo;
+	return 0;
+}
+/**
+Watches the folder dir and the ones in it, making every source
+file in them pending. Names starting with '.' are skipped.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int watch_add_dir(const char* dir) {
+	char real[PATH_MAX];
+	char path[4096];
+	struct dirent* de;
+	DIR* d;
+	int wd = inotify_add_watch(g_watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO
+		| IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+	if (wd < 0 || realpath(dir, real) == NULL) {
+		printf("error cannot watch folder '%s'\n", dir);
+		return __LINE__;
+	}
+	if (wd >= g_watch_dirs_alloced) {
+		struct watch_dir* newdirs;
+		int old = g_watch_dirs_alloced;
+		g_watch_dirs_alloced = wd + 64;
+		newdirs = realloc(g_watch_dirs, sizeof(struct watch_dir) * g_watch_dirs_alloced);
+		fail2malloc(newdirs, __LINE__);
+		g_watch_dirs = newdirs;
+		memset(g_watch_dirs + old, 0, sizeof(struct watch_dir) * (g_watch_dirs_alloced - old));
+	}
+	if (g_watch_dirs[wd].path == NULL) {
+		g_watch_dirs[wd].path = malloc(strlen(dir) + 1);
+		fail2malloc(g_watch_dirs[wd].path, __LINE__);
+		memcpy(g_watch_dirs[wd].path, dir, strlen(dir) + 1);
+	}
+	g_watch_dirs[wd].is_own = strcmp(real, g_watch_own_dir) == 0;
+	g_watch_dirs[wd].is_shard = g_watch_shard_dir[0] != '\0'
+		&& strcmp(real, g_watch_shard_dir) == 0;
+	d = opendir(dir);
+	if (d == NULL) {
+		printf("error cannot open folder '%s'\n", dir);
+		return __LINE__;
+	}
+	while ((de = readdir(d)) != NULL) {
+		struct stat st;
+		if (de->d_name[0] == '.') {
+			continue;
+		}
+		snprintf(path, sizeof path, "%s/%s", dir, de->d_name);
+		if (lstat(path, &st) != 0) {
+			continue;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			watch_add_dir(path);
+		}
+		else if (S_ISREG(st.st_mode) && is_source_name(de->d_name)
+			&& !g_watch_dirs[wd].is_shard
+			&& !(g_watch_dirs[wd].is_own && strcmp(de->d_name, g_watch_own_name) == 0)) {
+			watch_pending_add(path);
+		}
+	}
+	closedir(d);
+	return 0;
+}
+/**
+Parses again each pending path that still is a file, takes on the
+new ones and drops the ones that are gone.
+@return how many source files changed
+*/
+static int watch_refresh(void) {
+	int changed = 0;
+	int i;
+	for (i = 0; i < g_num_watch_pending; ++i) {
+		const char* path = g_watch_pending[i];
+		struct stat st;
+		int at;
+		int held = watch_find(path, &at);
+		int is_file = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+		if (held) {
+			contrib_free(&g_watch_srcs[at].c);
+		}
+		if (is_file && !held) {
+			if (g_num_watch_srcs == g_watch_srcs_alloced) {
+				struct watch_src* newsrcs;
+				g_watch_srcs_alloced += 64;
+				newsrcs = realloc(g_watch_srcs, sizeof(struct watch_src) * g_watch_srcs_alloced);
+				fail2malloc(newsrcs, __LINE__);
+				g_watch_srcs = newsrcs;
+			}
+			memmove(g_watch_srcs + at + 1, g_watch_srcs + at,
+				sizeof(struct watch_src) * (g_num_watch_srcs - at));
+			g_watch_srcs[at].path = g_watch_pending[i];
+			g_watch_pending[i] = NULL;
+			++g_num_watch_srcs;
+		}
+		if (is_file) {
+			contrib_scan(&g_watch_srcs[at].c, g_watch_srcs[at].path);
+			++changed;
+		}
+		else if (held) {
+			free(g_watch_srcs[at].path);
+			memmove(g_watch_srcs + at, g_watch_srcs + at + 1,
+				sizeof(struct watch_src) * (g_num_watch_srcs - at - 1));
+			--g_num_watch_srcs;
+			++changed;
+		}
+		free(g_watch_pending[i]);
+	}
+	g_num_watch_pending = 0;
+	return changed;
+}
+/**
+Makes james.h afresh from every source file held, under the lock,
+moving it into place only if it changed.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int watch_write(const char* james_h) {
+	FILE* j;
+	int ret = 0;
+	int i;
+	james_state_clear();
+	ret = lock();
+	if (ret) {
+		return ret;
+	}
+	j = create_james_h(james_h);
+	if (j == NULL) {
+		unlock();
+		return __LINE__;
+	}
+	for (i = 0; i < g_num_watch_srcs && ret == 0; ++i) {
+		ret = contrib_apply_src(&g_watch_srcs[i].c, g_watch_srcs[i].path, j);
+		if (ret != 0) {
+			/*--put in place with the error in it, as without --watch--*/
+			fprintf(j, "\n/* (while processing file %s) */\n", g_watch_srcs[i].path);
+			printf("\n/* (while processing file %s) */\n", g_watch_srcs[i].path);
+		}
+	}
+	if (ret == 0) {
+		shard_set_base(james_h);
+		finish_james_h(j);
+	}
+	i = commit_james_h(j, james_h);
+	if (ret == 0 && i == 0) {
+		state_save(james_h);
+	}
+	unlock();
+	return ret ? ret : i;
+}
+/**
+Reads what inotify has to say, making the source files it names
+pending and watching new folders.
+*/
+static void watch_read_events(char** roots, int num_roots) {
+	union {
+		struct inotify_event ev;
+		char buf[16384];
+	} u;
+	char path[4096];
+	ssize_t len = read(g_watch_fd, u.buf, sizeof u.buf);
+	ssize_t at = 0;
+	while (at + (ssize_t)sizeof(struct inotify_event) <= len) {
+		const struct inotify_event* ev = (const struct inotify_event*)(u.buf + at);
+		struct watch_dir* wdir;
+		at += sizeof(struct inotify_event) + ev->len;
+		if (ev->mask & IN_Q_OVERFLOW) {
+			/*--events were lost, so look at everything again--*/
+			int i;
+			for (i = 0; i < g_num_watch_srcs; ++i) {
+				watch_pending_add(g_watch_srcs[i].path);
+			}
+			for (i = 0; i < num_roots; ++i) {
+				watch_add_dir(roots[i]);
+			}
+			continue;
+		}
+		if (ev->wd < 0 || ev->wd >= g_watch_dirs_alloced
+			|| g_watch_dirs[ev->wd].path == NULL) {
+			continue;
+		}
+		wdir = &g_watch_dirs[ev->wd];
+		if (ev->mask & IN_IGNORED) {
+			free(wdir->path);
+			wdir->path = NULL;
+			continue;
+		}
+		if (ev->len == 0 || ev->name[0] == '.') {
+			continue;
+		}
+		snprintf(path, sizeof path, "%s/%s", wdir->path, ev->name);
+		if (ev->mask & IN_ISDIR) {
+			if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+				watch_add_dir(path);
+			}
+			else {
+				watch_pending_under(path);
+			}
+		}
+		else if (is_source_name(ev->name) && !wdir->is_shard
+			&& !(wdir->is_own && strcmp(ev->name, g_watch_own_name) == 0)) {
+			watch_pending_add(path);
+		}
+	}
+}
+/**
+Makes james.h from the source files in the folders roots, and
+then again each time any of them change, until interrupted.
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int watch_main(const char* james_h, char** roots, int num_roots) {
+	char dir[4096];
+	const char* sep = strrchr(james_h, '/');
+	int i;
+	int ret = 0;
+	if (sep == NULL) {
+		g_watch_own_name = james_h;
+		snprintf(dir, sizeof dir, ".");
+	}
+	else {
+		g_watch_own_name = sep + 1;
+		snprintf(dir, sizeof dir, "%.*s", (sep > james_h) ? (int)(sep - james_h) : 1, james_h);
+	}
+	if (realpath(dir, g_watch_own_dir) == NULL) {
+		printf("error cannot find folder '%s'\n", dir);
+		return __LINE__;
+	}
+	g_watch_shard_dir[0] = '\0';
+	if (g_shard_dir != NULL) {
+		shard_set_base(james_h);
+		if (realpath(g_shard_base, g_watch_shard_dir) == NULL) {
+			g_watch_shard_dir[0] = '\0';
+		}
+	}
+	if (lock_set_target(james_h) != 0) {
+		return __LINE__;
+	}
+	g_watch_fd = inotify_init();
+	if (g_watch_fd < 0) {
+		puts("error cannot start inotify");
+		return __LINE__;
+	}
+	for (i = 0; i < num_roots && ret == 0; ++i) {
+		/*--"src/" and "src" should give the same paths--*/
+		int n = strlen(roots[i]);
+		while (n > 1 && roots[i][n - 1] == '/') {
+			roots[i][--n] = '\0';
+		}
+		ret = watch_add_dir(roots[i]);
+	}
+	if (ret != 0) {
+		close(g_watch_fd);
+		return ret;
+	}
+	signal(SIGINT, watch_on_signal);
+	signal(SIGTERM, watch_on_signal);
+	watch_refresh();
+	watch_write(james_h);
+	printf("watching %d source files for '%s'\n", g_num_watch_srcs, james_h);
+	fflush(stdout);
+	while (!g_watch_stop) {
+		fd_set rfds;
+		struct timeval tv;
+		int n;
+		FD_ZERO(&rfds);
+		FD_SET(g_watch_fd, &rfds);
+		tv.tv_sec = g_watch_debounce / 1000;
+		tv.tv_usec = (g_watch_debounce % 1000) * 1000;
+		n = select(g_watch_fd + 1, &rfds, NULL, NULL,
+			g_num_watch_pending > 0 ? &tv : NULL);
+		if (n < 0) {
+			continue;
+		}
+		if (n > 0) {
+			watch_read_events(roots, num_roots);
+			continue;
+		}
+		/*--quiet for long enough, so make james.h--*/
+		n = watch_refresh();
+		if (n > 0) {
+			watch_write(james_h);
+			printf("%d changed, wrote '%s'\n", n, james_h);
+			fflush(stdout);
+		}
+	}
+	close(g_watch_fd);
+	return 0;
+}
+#endif
+
+/*--with --stdin the source files come in on stdin, one after the
+other, and james.h goes out to "-o" rather than being loaded and
+written in place, so there is no lock file nor any temp file, for
+builds that run james where it may only touch what it is given.
+With --name-from-markers, lines like "#line 1 \"src/main.c\"" or
+"# 1 \"src/main.c\"" as cpp writes them start the next source file,
+so the "@file:line$" markers name the file and line they came from--*/
+/**
+@param line
+the line, not null terminated
+@param name
+set to the file name of the marker
+@return 1 if line is a file and line marker, otherwise 0
+*/
+static int line_marker(const char* line, long n, long* lineno, char* name, int namesz) {
+	char buf[4096];
+	char* p = buf;
+	char* end;
+	int w = 0;
+	if (n >= (long)sizeof buf) {
+		return 0;
+	}
+	memcpy(buf, line, n);
+	buf[n] = '\0';
+	while (*p == ' ' || *p == '\t') {
+		++p;
+	}
+	if (*p != '#') {
+		return 0;
+	}
+	++p;
+	while (*p == ' ' || *p == '\t') {
+		++p;
+	}
+	if (strncmp(p, "line", 4) == 0) {
+		p += 4;
+	}
+	if (!isdigit((unsigned char)*(p + strspn(p, " \t")))) {
+		return 0;
+	}
+	*lineno = strtol(p, &end, 10);
+	p = end + strspn(end, " \t");
+	if (*p != '"') {
+		return 0;
+	}
+	for (++p; *p != '\0' && *p != '"'; ++p) {
+		if (*p == '\\' && p[1] != '\0') {
+			++p;
+		}
+		if (w + 1 < namesz) {
+			name[w++] = *p;
+		}
+	}
+	name[w] = '\0';
+	return *p == '"';
+}
+/**
+Parses one source file of the stream and applies it.
+@param first_line
+the line number of its first line
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int stdin_segment(const char* buf, long n, const char* name, long first_line, FILE* out) {
+	struct contrib c;
+	struct contrib_rec* r;
+	char fname[sizeof g_je_filename];
+	int ret;
+	src_basename(fname, name);
+	contrib_init(&c, fname);
+	contrib_parse_buf(&c, buf, n);
+	for (r = c.head; r != NULL; r = r->next) {
+		r->lineno += (int)first_line - 1;
+	}
+	ret = contrib_apply_src(&c, name, out);
+	contrib_free(&c);
+	if (ret != 0) {
+		fprintf(out, "\n/* (while processing file %s) */\n", name);
+		printf("\n/* (while processing file %s) */\n", name);
+	}
+	return ret;
+}
+/**
+Reads the source files from stdin and writes james.h to out_path.
+@param james_h_opt
+an existing james.h to start from, it is only read
+@param out_path
+where to write james.h, "-" for stdout
+@return
+0 on okay, otherwise the line number of where the error was tested
+*/
+static int stdin_main(const char* james_h_opt, const char* out_path, int from_markers) {
+	FILE* out;
+	char* buf;
+	long len = 0;
+	long cap = 65536;
+	long at = 0;
+	long seg_start = 0;
+	long seg_line = 1;
+	char name[4096] = "stdin";
+	int ret = 0;
+	if (g_shard_dir != NULL) {
+		puts("error --stdin writes one james.h, so no --shard-dir");
+		return __LINE__;
+	}
+	if (strcmp(out_path, "-") == 0) {
+		/*--james.h goes to stdout, so what james says goes to stderr--*/
+#ifdef _MSC_VER
+		int fd = _dup(1);
+		_dup2(2, 1);
+		out = (fd >= 0) ? _fdopen(fd, "w") : NULL;
+#elif defined(_POSIX_SOURCE)
+		int fd = dup(1);
+		dup2(2, 1);
+		out = (fd >= 0) ? fdopen(fd, "w") : NULL;
+#else
+		puts("error james.h to stdout needs POSIX or Windows");
+		return __LINE__;
+#endif
+	}
+	else {
+		out = fopen(out_path, "w");
+	}
+	if (out == NULL) {
+		printf("error cannot open '%s' for writing\n", out_path);
+		return __LINE__;
+	}
+	buf = malloc(cap);
+	fail2malloc(buf, __LINE__);
+	while (1) {
+		size_t got = fread(buf + len, 1, cap - len, stdin);
+		len += (long)got;
+		if (got == 0) {
+			break;
+		}
+		if (len == cap) {
+			char* newbuf;
+			cap *= 2;
+			newbuf = realloc(buf, cap);
+			fail2malloc(newbuf, __LINE__);
+			buf = newbuf;
+		}
+	}
+	if (james_h_opt != NULL) {
+		ret = load_james_h(james_h_opt);
+	}
+	james_h_start(out);
+	while (ret == 0 && at < len) {
+		const char* nl = memchr(buf + at, '\n', len - at);
+		long end = (nl != NULL) ? (long)(nl - buf) : len;
+		long lineno;
+		char newname[4096];
+		if (from_markers && line_marker(buf + at, end - at, &lineno, newname, sizeof newname)) {
+			ret = stdin_segment(buf + seg_start, at - seg_start, name, seg_line, out);
+			memcpy(name, newname, strlen(newname) + 1);
+			seg_line = lineno;
+			seg_start = end + 1;
+		}
+		at = end + 1;
+	}
+	if (ret == 0 && seg_start < len) {
+		ret = stdin_segment(buf + seg_start, len - seg_start, name, seg_line, out);
+	}
+	free(buf);
+	if (ret == 0) {
+		finish_james_h(out);
+	}
+	if (fclose(out) != 0 && ret == 0) {
+		printf("error cannot write '%s'\n", out_path);
+		ret = __LINE__;
+	}
+	return ret;
+}
+#endif
+
+/*--what lib/libjames.h offers, a session being the james_state of
+the --daemon with the swapping in and out done for the caller--*/
+#include "../lib/libjames.h"
+struct james_session {
+	struct james_state st;
+};
+/**
+Swaps the session into ram, keeping what was there in outer.
+*/
+static void james_session_enter(struct james_session* s, struct james_state* outer) {
+	james_state_save(outer);
+	james_state_load(&s->st);
+}
+/**
+Swaps the session out of ram again, and outer back in.
+*/
+static void james_session_leave(struct james_session* s, const struct james_state* outer) {
+	james_state_save(&s->st);
+	james_state_load(outer);
+}
+struct james_session* james_session_new(void) {
+	struct james_session* s;
+	if (setjmp(g_lib_bail) != 0) {
+		return NULL;
+	}
+	s = malloc(sizeof(struct james_session));
+	fail2malloc(s, __LINE__);
+	memset(&s->st, 0, sizeof s->st);
+	lex_build();
+	return s;
+}
+void james_session_free(struct james_session* s) {
+	struct james_state outer;
+	if (s == NULL) {
+		return;
+	}
+	james_session_enter(s, &outer);
+	james_state_clear();
+	james_session_leave(s, &outer);
+	free(s);
+}
+/*--the james_* calls below do their work in these, inside the
+session and with somewhere to give up to, see give_up()--*/
+static int lib_add_source(const char* buf, long len, const char* name) {
+	struct contrib c;
+	char fname[sizeof g_je_filename];
+	int ret;
+	src_basename(fname, name);
+	contrib_init(&c, fname);
+	contrib_parse_buf(&c, buf, len);
+	if (c.cant_open) {
+		printf("error cannot read source '%s'\n", name);
+		contrib_free(&c);
+		return c.ret;
+	}
+	ret = contrib_apply_src(&c, name, NULL);
+	contrib_free(&c);
+	if (ret != 0) {
+		printf("\n/* (while processing file %s) */\n", name);
+	}
+	return ret;
+}
+static int lib_load_state(const char* james_h) {
+	james_state_clear();
+	return load_james_h(james_h);
+}
+static int lib_render(FILE* out) {
+	james_h_start(out);
+	finish_james_h(out);
+	return 0;
+}
+static int lib_write(const char* james_h) {
+	FILE* j;
+	int ret;
+	ret = lock_set_target(james_h);
+	if (ret == 0) {
+		ret = lock();
+	}
+	if (ret) {
+		return ret;
+	}
+	shard_set_base(james_h);
+	j = create_james_h(james_h);
+	if (j == NULL) {
+		ret = __LINE__;
+	}
+	else {
+		finish_james_h(j);
+		ret = commit_james_h(j, james_h);
+		if (ret == 0) {
+			state_save(james_h);
+		}
+	}
+	unlock();
+	return ret;
+}
+int james_add_source(struct james_session* s, const char* buf, long len,
+	const char* name) {
+	struct james_state outer;
+	int ret;
+	james_session_enter(s, &outer);
+	if (setjmp(g_lib_bail) == 0) {
+		ret = lib_add_source(buf, len, name);
+	}
+	else {
+		ret = g_lib_bail_line;
+	}
+	james_session_leave(s, &outer);
+	return ret;
+}
+int james_load_state(struct james_session* s, const char* james_h) {
+	struct james_state outer;
+	int ret;
+	james_session_enter(s, &outer);
+	if (setjmp(g_lib_bail) == 0) {
+		ret = lib_load_state(james_h);
+	}
+	else {
+		ret = g_lib_bail_line;
+	}
+	james_session_leave(s, &outer);
+	return ret;
+}
+int james_render(struct james_session* s, FILE* out) {
+	struct james_state outer;
+	int ret;
+	james_session_enter(s, &outer);
+	if (setjmp(g_lib_bail) == 0) {
+		ret = lib_render(out);
+	}
+	else {
+		ret = g_lib_bail_line;
+	}
+	james_session_leave(s, &outer);
+	if (ret == 0 && (fflush(out) != 0 || ferror(out))) {
+		ret = __LINE__;
+	}
+	return ret;
+}
+int james_write(struct james_session* s, const char* james_h) {
+	struct james_state outer;
+	int ret;
+	james_session_enter(s, &outer);
+	if (setjmp(g_lib_bail) == 0) {
+		ret = lib_write(james_h);
+	}
+	else {
+		/*--let go of the lock, should it have given up holding it--*/
+		unlock();
+		ret = g_lib_bail_line;
+	}
+	james_session_leave(s, &outer);
+	return ret;
+}
+
+#ifndef JAMES_NO_MAIN
+/*--with --stats how long this run took, how long it waited for the
+lock, and how long it held it, for bench/contention.c--*/
+static long g_start_ms = 0;
+static int g_stat_retries = 0;
+static void print_stats(void) {
+	printf("stats: lock_wait_ms=%ld locked_ms=%ld total_ms=%ld retries=%d\n",
+		g_lock_wait_total_ms, g_lock_held_ms, now_ms() - g_start_ms,
+		g_stat_retries);
+}
+int main(int argc, char** argv){
+	FILE *j;
+	const char * james_h;
+	int i;
+	int argi = 1;
+	int subret;
+	const char* daemon_sock = NULL;
+	const char* client_sock = NULL;
+	int client_flush = 0;
+	int client_reset = 0;
+	int client_stop = 0;
+	int use_cache = 0;
+	char cache_path[4096];
+	/*--james.h was made with --cache and has not changed since,
+	so the cache says what each source file contributed--*/
+	int from_cache = 0;
+	int had_james_h = 0;
+	int num_forget = 0;
+	const char* forget[64];
+	int want_depfile = 0;
+	char depfile_path[4096];
+	const char* spool_dir = NULL;
+	const char* merge_dir = NULL;
+	int optimistic = 0;
+	int retries = 0;
+	int journal = 0;
+	int compact = 0;
+	int watch = 0;
+	int from_stdin = 0;
+	int name_from_markers = 0;
+	const char* out_path = NULL;
+
+	/*--before any threads parse--*/
+	lex_build();
+	while (argi < argc && argv[argi][0] == '-') {
+		if (strncmp(argv[argi], "-j", 2) == 0) {
+			if (argv[argi][2] != '\0') {
+				g_num_jobs = strtol(argv[argi] + 2, NULL, 10);
+			}
+			else if (argi + 1 < argc) {
+				++argi;
+				g_num_jobs = strtol(argv[argi], NULL, 10);
+			}
+		}
+		else if (strcmp(argv[argi], "--daemon") == 0 && argi + 1 < argc) {
+			++argi;
+			daemon_sock = argv[argi];
+		}
+		else if (strcmp(argv[argi], "--client") == 0 && argi + 1 < argc) {
+			++argi;
+			client_sock = argv[argi];
+		}
+		else if (strcmp(argv[argi], "--idle-flush") == 0 && argi + 1 < argc) {
+			++argi;
+#ifdef _POSIX_SOURCE
+			g_idle_flush = strtol(argv[argi], NULL, 10);
+#endif
+		}
+		else if (strcmp(argv[argi], "--scan-dir") == 0 && argi + 1 < argc
+			&& g_num_scan_dirs < (int)(sizeof g_scan_dirs / sizeof g_scan_dirs[0])) {
+			++argi;
+			g_scan_dirs[g_num_scan_dirs] = argv[argi];
+			++g_num_scan_dirs;
+		}
+		else if (strcmp(argv[argi], "--include") == 0 && argi + 1 < argc
+			&& g_num_scan_includes < (int)(sizeof g_scan_includes / sizeof g_scan_includes[0])) {
+			++argi;
+			g_scan_includes[g_num_scan_includes] = argv[argi];
+			++g_num_scan_includes;
+		}
+		else if (strcmp(argv[argi], "--exclude") == 0 && argi + 1 < argc
+			&& g_num_scan_excludes < (int)(sizeof g_scan_excludes / sizeof g_scan_excludes[0])) {
+			++argi;
+			g_scan_excludes[g_num_scan_excludes] = argv[argi];
+			++g_num_scan_excludes;
+		}
+		else if (strcmp(argv[argi], "--no-uring") == 0) {
+#ifdef JAMES_URING
+			g_use_uring = 0;
+#endif
+		}
+		else if (strcmp(argv[argi], "--max-size") == 0 && argi + 1 < argc) {
+			++argi;
+			g_scan_max_size = strtol(argv[argi], NULL, 10);
+		}
+		else if (strcmp(argv[argi], "--stdin") == 0) {
+			from_stdin = 1;
+		}
+		else if (strcmp(argv[argi], "--name-from-markers") == 0) {
+			name_from_markers = 1;
+		}
+		else if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+			++argi;
+			out_path = argv[argi];
+		}
+		else if (strcmp(argv[argi], "--watch") == 0) {
+			watch = 1;
+		}
+		else if (strcmp(argv[argi], "--debounce") == 0 && argi + 1 < argc) {
+			++argi;
+#ifdef JAMES_WATCH
+			g_watch_debounce = strtol(argv[argi], NULL, 10);
+#endif
+		}
+		else if (strcmp(argv[argi], "--cache") == 0) {
+			use_cache = 1;
+		}
+		else if (strcmp(argv[argi], "--stats") == 0) {
+			g_start_ms = now_ms();
+			atexit(print_stats);
+		}
+		else if (strcmp(argv[argi], "--journal") == 0) {
+			journal = 1;
+		}
+		else if (strcmp(argv[argi], "--compact") == 0) {
+			compact = 1;
+		}
+		else if (strcmp(argv[argi], "--compact-at") == 0 && argi + 1 < argc) {
+			++argi;
+			g_compact_at = strtol(argv[argi], NULL, 10);
+		}
+		else if (strcmp(argv[argi], "--optimistic") == 0) {
+			optimistic = 1;
+		}
+		else if (strcmp(argv[argi], "--lock-timeout") == 0 && argi + 1 < argc) {
+			++argi;
+			g_lock_timeout = strtol(argv[argi], NULL, 10);
+		}
+		else if (strcmp(argv[argi], "--spool") == 0 && argi + 1 < argc) {
+			++argi;
+			spool_dir = argv[argi];
+		}
+		else if (strcmp(argv[argi], "--merge") == 0 && argi + 1 < argc) {
+			++argi;
+			merge_dir = argv[argi];
+		}
+		else if (strcmp(argv[argi], "-MD") == 0) {
+			want_depfile = 1;
+		}
+		else if (strcmp(argv[argi], "-MF") == 0 && argi + 1 < argc) {
+			++argi;
+			g_depfile = argv[argi];
+			want_depfile = 1;
+		}
+		else if (strcmp(argv[argi], "--shard-dir") == 0 && argi + 1 < argc) {
+			++argi;
+			g_shard_dir = argv[argi];
+		}
+		else if (strcmp(argv[argi], "--forget") == 0 && argi + 1 < argc
+			&& num_forget < (int)(sizeof forget / sizeof forget[0])) {
+			++argi;
+			forget[num_forget] = argv[argi];
+			++num_forget;
+			use_cache = 1;
+		}
+		else if (strcmp(argv[argi], "--flush") == 0) {
+			client_flush = 1;
+		}
+		else if (strcmp(argv[argi], "--reset") == 0) {
+			client_reset = 1;
+		}
+		else if (strcmp(argv[argi], "--stop") == 0) {
+			client_stop = 1;
+		}
+		else {
+			printf("error unknown option '%s'\n", argv[argi]);
+			return __LINE__;
+		}
+		++argi;
+	}
+
+	if (daemon_sock != NULL || client_sock != NULL) {
+#ifdef _POSIX_SOURCE
+		if (daemon_sock != NULL) {
+			return daemon_main(daemon_sock);
+		}
+		james_h = NULL;
+		if (argi < argc) {
+			james_h = argv[argi];
+		}
+		for (i = argi + 1; i < argc; ++i) {
+			if (argv[i][0] == '@') {
+				int listret = add_src_list(argv[i] + 1);
+				if (listret) {
+					return listret;
+				}
+			}
+			else {
+				add_src(argv[i]);
+			}
+		}
+		return client_main(client_sock, james_h,
+			client_flush, client_reset, client_stop);
+#else
+		(void)client_flush;
+		(void)client_reset;
+		(void)client_stop;
+		puts("error --daemon and --client need POSIX");
+		return __LINE__;
+#endif
+	}
 	
+	if (spool_dir != NULL) {
+		/*--no james.h, every argument is a source file--*/
+		for (i = argi; i < argc; ++i) {
+			if (argv[i][0] == '@') {
+				int listret = add_src_list(argv[i] + 1);
+				if (listret) {
+					return listret;
+				}
+			}
+			else {
+				add_src(argv[i]);
+			}
+		}
+		if (g_num_scan_dirs > 0) {
+			subret = scan_dirs(NULL);
+			if (subret) {
+				return subret;
+			}
+		}
+		return spool_main(spool_dir);
+	}
 
-	fclose(j);
-	fclose(s);
+	if (from_stdin) {
+		if (argc - argi > 1) {
+			puts("error --stdin takes no source files, pipe them in");
+			return __LINE__;
+		}
+		return stdin_main(argi < argc ? argv[argi] : NULL,
+			out_path != NULL ? out_path : "-", name_from_markers);
+	}
+
+	if (watch) {
+#ifdef JAMES_WATCH
+		if (argc - argi < 2) {
+			puts("error --watch needs path\\to\\james.h and the folders to watch");
+			return __LINE__;
+		}
+		return watch_main(argv[argi], argv + argi + 1, argc - argi - 1);
+#else
+		puts("error --watch needs inotify and POSIX, which is Linux only");
+		return __LINE__;
+#endif
+	}
+
+	if (argc - argi < (merge_dir != NULL || compact || g_num_scan_dirs > 0 ? 1 : 2)) {
+		if (isdebug()) {
+			james_h = "C:\\dev\\fsrc\\ginclude\\james.h";
+			//remove(james_h);
+			add_src("C:\\dev\\fsrc\\lib\\everynms.h");
+		}
+		else {
+			puts("usage: [-j N] [--no-uring] [--cache] [--forget source\\file.c] [--shard-dir folder] [-MD] [-MF depfile] [--lock-timeout seconds] [--optimistic] [--journal [--compact-at bytes]] [--stats] path\\to\\james.h source\\file.c [more\\source.c ...] [@filelist]");
+			puts("   or: [options as above] --scan-dir folder [--scan-dir folder ...] [--include glob ...] [--exclude glob ...] [--max-size bytes] path\\to\\james.h [source\\file.c ...]");
+			puts("   or: --spool folder [-j N] [--scan-dir folder ...] source\\file.c [more\\source.c ...] [@filelist]");
+			puts("   or: --compact [--cache] [--shard-dir folder] [-MD] [-MF depfile] path\\to\\james.h");
+			puts("   or: --merge folder [--cache] [--shard-dir folder] [-MD] [-MF depfile] path\\to\\james.h");
+			puts("   or: --stdin [--name-from-markers] [-o path\\to\\james.h|-] [path\\to\\old\\james.h] < sources");
+			puts("   or: --watch [--debounce ms] [--shard-dir folder] path\\to\\james.h source\\folder [more\\folder ...]");
+			puts("   or: --daemon socket [--idle-flush seconds] [--shard-dir folder]");
+			puts("   or: --client socket [--reset] [--flush] [--stop] [path\\to\\james.h [source\\file.c ...]]");
+			return 1;
+		}
+	}
+	else {
+		james_h = argv[argi];
+		for (i = argi + 1; i < argc; ++i) {
+			if (argv[i][0] == '@') {
+				int listret = add_src_list(argv[i] + 1);
+				if (listret) {
+					return listret;
+				}
+			}
+			else {
+				add_src(argv[i]);
+			}
+		}
+		if (g_num_scan_dirs > 0) {
+			subret = scan_dirs(james_h);
+			if (subret) {
+				return subret;
+			}
+		}
+	}
 	
-	unlock();
-	return 0;
+	
+	if (merge_dir != NULL) {
+		if (g_num_srcs > 0) {
+			puts("error --merge takes no source files, spool them instead");
+			return __LINE__;
+		}
+		subret = merge_load(merge_dir);
+		if (subret) {
+			return subret;
+		}
+	}
+
+	/*--parse all the source files before taking the lock, as that
+	changes nothing shared, so the lock is only held while james.h
+	is loaded, added to and written--*/
+	if (use_cache) {
+		snprintf(cache_path, sizeof cache_path, "%s.cache", james_h);
+		g_cache_path = cache_path;
+		cache_load(g_cache_path);
+	}
+	contrib_scan_all();
+
+	subret = lock_set_target(james_h);
+	if (subret) {
+		return subret;
+	}
+	if (journal) {
+		long journal_size = 0;
+		subret = lock();
+		if (subret == 0) {
+			subret = journal_append(james_h, &journal_size);
+			unlock();
+		}
+		if (subret || g_compact_at <= 0 || journal_size < g_compact_at) {
+			return subret;
+		}
+		/*--big enough to fold into james.h now, with no source files
+		of its own as they are all in the journal already--*/
+		for (i = 0; i < g_num_srcs; ++i) {
+			contrib_free(&g_contribs[i]);
+		}
+		g_num_srcs = 0;
+	}
+	if (optimistic) {
+		g_keep_contribs = 1;
+		g_defer_shards = 1;
+#ifdef _POSIX_SOURCE
+		snprintf(g_tmp_ext, sizeof g_tmp_ext, ".%ld.tmp", (long)getpid());
+#endif
+	}
+	while (1) {
+		struct header_token before;
+		if (!optimistic) {
+			subret = lock();
+			if (subret) {
+				return subret;
+			}
+		}
+		header_token_get(james_h, &before);
+		from_cache = 0;
+
+		{
+			struct hash64 h;
+			had_james_h = (file_hash(james_h, &h) == 0);
+			if (use_cache) {
+				/*--in case another run saved it while we were parsing--*/
+				cache_reload(g_cache_path);
+				if (had_james_h && g_cache_have_h && hash64_same(h, g_cache_h)) {
+					from_cache = 1;
+				}
+				else {
+					/*--james.h was made some other way, or was deleted
+					to start afresh, so the cache only saves parsing--*/
+					cache_clear_live();
+				}
+				for (i = 0; i < num_forget; ++i) {
+					struct cache_entry* e = cache_find(forget[i]);
+					if (e != NULL) {
+						e->live = 0;
+					}
+					if (!from_cache) {
+						printf("warning cannot forget '%s' as %s was not made by --cache\n",
+							forget[i], james_h);
+					}
+				}
+				/*--where each source file comes in the cache order--*/
+				for (i = 0; i < g_num_srcs; ++i) {
+					struct cache_entry* e = cache_find(g_srcs[i]);
+					if (e == NULL) {
+						e = cache_add(g_srcs[i]);
+					}
+					e->src_i = i;
+				}
+			}
+		}
+	
+		/*--load everything from the previous run only once, no
+		matter how many source files we are given, unless the cache
+		says what each source file contributed, then the source files
+		being parsed again are dropped and what they contribute now
+		takes their place--*/
+		if (want_depfile) {
+			if (g_depfile == NULL) {
+				snprintf(depfile_path, sizeof depfile_path, "%s.d", james_h);
+				g_depfile = depfile_path;
+			}
+			if (!from_cache && had_james_h) {
+				dep_load(g_depfile);
+			}
+		}
+		if (!from_cache) {
+			subret = load_james_h(james_h);
+			if (subret) {
+				unlock();
+				return subret;
+			}
+		}
+		j = create_james_h(james_h);
+		if (j == NULL) {
+			unlock();
+			return __LINE__;
+		}
+
+		/*--what runs with --journal added since, before our own--*/
+		subret = journal_replay(james_h, j, from_cache);
+		if (subret) {
+			commit_james_h_on_error(j, james_h, optimistic ? &before : NULL);
+			return subret;
+		}
+
+		/*--real parse, of each source file, which may be done on many
+		threads, but they are always applied in the order given so it
+		is the same no matter how many threads--*/
+		if (from_cache) {
+			struct cache_entry* e;
+			for (e = g_cache_head; e != NULL; e = e->next) {
+				int second_subret = 0;
+				if (e->src_i >= 0) {
+					second_subret = run_src(e->src_i, j);
+				}
+				else if (e->live) {
+					second_subret = contrib_apply_src(&e->c, e->path, j);
+					if (second_subret == 0 && e->c.contributed) {
+						dep_add(e->path);
+					}
+				}
+				if (second_subret != 0) {
+					commit_james_h_on_error(j, james_h, optimistic ? &before : NULL);
+					return second_subret;
+				}
+			}
+		}
+		else {
+			for (i = 0; i < g_num_srcs; ++i) {
+				int second_subret = run_src(i, j);
+				if (second_subret != 0) {
+					/*--still put in place, with the error in it--*/
+					commit_james_h_on_error(j, james_h, optimistic ? &before : NULL);
+					/*--don't want to return 0, so that build system knows problem--*/
+					return second_subret;
+				}
+			}
+		}
+
+		/*--and only now write out the ram, once for all of them--*/
+		shard_set_base(james_h);
+		finish_james_h(j);
+
+		if (optimistic) {
+			/*--only now take the lock, to check that nobody else wrote
+			james.h since it was loaded, otherwise start again--*/
+			struct header_token after;
+			subret = close_james_h(j, james_h);
+			if (subret) {
+				shards_pending_finish(0);
+				return subret;
+			}
+			subret = lock();
+			if (subret) {
+				char tmp[TMP_PATH_LEN];
+				snprintf(tmp, sizeof tmp, "%s%s", james_h, g_tmp_ext);
+				remove(tmp);
+				shards_pending_finish(0);
+				return subret;
+			}
+			header_token_get(james_h, &after);
+			if (!header_token_same(&before, &after)) {
+				char tmp[TMP_PATH_LEN];
+				unlock();
+				snprintf(tmp, sizeof tmp, "%s%s", james_h, g_tmp_ext);
+				remove(tmp);
+				shards_pending_finish(0);
+				james_state_clear();
+				dep_clear();
+				++retries;
+				++g_stat_retries;
+				if (retries >= g_optimistic_retries) {
+					/*--too busy, so wait our turn like everyone else--*/
+					optimistic = 0;
+					g_defer_shards = 0;
+				}
+				continue;
+			}
+			subret = move_james_h(james_h);
+			shards_pending_finish(subret == 0);
+		}
+		else {
+			subret = commit_james_h(j, james_h);
+		}
+		if (subret) {
+			unlock();
+			return subret;
+		}
+		{
+			/*--it is all in james.h now--*/
+			char path[4096];
+			journal_path(path, sizeof path, james_h);
+			remove(path);
+		}
+		state_save(james_h);
+		if (g_depfile != NULL) {
+			subret = dep_save(james_h);
+			if (subret) {
+				unlock();
+				return subret;
+			}
+		}
+
+		if (g_cache_path != NULL) {
+			g_cache_have_h = (from_cache || !had_james_h)
+				&& file_hash(james_h, &g_cache_h) == 0;
+			subret = cache_save(g_cache_path);
+			if (subret) {
+				unlock();
+				return subret;
+			}
+		}
+	
+		unlock();
+		return 0;
+	}
 }
+#endif